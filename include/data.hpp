@@ -9,51 +9,213 @@
 
 #include <string>
 #include <vector>
+#include <new>
+#include <iterator>
+#include <compare>
+#include <memory>
+#include <cstdint>
 
 #include "portfolio.hpp"
 
 namespace swr {
 
+// A single point of historical data
 struct data {
     size_t month;
     size_t year;
     float  value;
 };
 
+// Allocate the series on cache line boundaries
+template <typename T, size_t Alignment = 64>
+struct aligned_allocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = aligned_allocator<U, Alignment>;
+    };
+
+    aligned_allocator() = default;
+
+    template <typename U>
+    aligned_allocator(const aligned_allocator<U, Alignment>& /*other*/) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{Alignment}));
+    }
+
+    void deallocate(T* ptr, size_t /*n*/) {
+        ::operator delete(ptr, std::align_val_t{Alignment});
+    }
+
+    template <typename U>
+    bool operator==(const aligned_allocator<U, Alignment>& /*other*/) const {
+        return true;
+    }
+};
+
+using series = std::vector<float, aligned_allocator<float>>;
+
+// A view of one point of a data_vector, the date is computed from the calendar
+template <typename T>
+struct data_ref {
+    size_t month;
+    size_t year;
+    T&     value;
+};
+
+template <typename V, typename T>
+struct data_iterator {
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type        = swr::data;
+    using difference_type   = std::ptrdiff_t;
+    using reference         = data_ref<T>;
+
+    struct pointer {
+        reference ref;
+
+        reference* operator->() {
+            return &ref;
+        }
+    };
+
+    V*     values = nullptr;
+    size_t index  = 0;
+
+    data_iterator() = default;
+    data_iterator(V* values, size_t index) : values(values), index(index) {}
+
+    // Allow conversion from iterator to const_iterator
+    template <typename V2, typename T2>
+    data_iterator(const data_iterator<V2, T2>& rhs) : values(rhs.values), index(rhs.index) {}
+
+    reference operator*() const {
+        return {values->month_of(index), values->year_of(index), values->data[index]};
+    }
+
+    pointer operator->() const {
+        return {**this};
+    }
+
+    reference operator[](difference_type n) const {
+        return *(*this + n);
+    }
+
+    data_iterator& operator++() {
+        ++index;
+        return *this;
+    }
+
+    data_iterator operator++(int) {
+        auto copy = *this;
+        ++index;
+        return copy;
+    }
+
+    data_iterator& operator--() {
+        --index;
+        return *this;
+    }
+
+    data_iterator operator--(int) {
+        auto copy = *this;
+        --index;
+        return copy;
+    }
+
+    data_iterator& operator+=(difference_type n) {
+        index += n;
+        return *this;
+    }
+
+    data_iterator& operator-=(difference_type n) {
+        index -= n;
+        return *this;
+    }
+
+    friend data_iterator operator+(data_iterator it, difference_type n) {
+        return it += n;
+    }
+
+    friend data_iterator operator+(difference_type n, data_iterator it) {
+        return it += n;
+    }
+
+    friend data_iterator operator-(data_iterator it, difference_type n) {
+        return it -= n;
+    }
+
+    friend difference_type operator-(const data_iterator& lhs, const data_iterator& rhs) {
+        return static_cast<difference_type>(lhs.index) - static_cast<difference_type>(rhs.index);
+    }
+
+    friend bool operator==(const data_iterator& lhs, const data_iterator& rhs) {
+        return lhs.index == rhs.index;
+    }
+
+    friend auto operator<=>(const data_iterator& lhs, const data_iterator& rhs) {
+        return lhs.index <=> rhs.index;
+    }
+};
+
+// Monthly series stored in columnar form: one contiguous (and aligned) array
+// of values and the date of the first point. There are no gaps in the data,
+// the date of each point is implied by its position.
 struct data_vector {
-    using vector_type = std::vector<swr::data>;
-    using iterator    = vector_type::iterator;
-    using value_type  = vector_type::value_type;
+    using vector_type    = swr::series;
+    using iterator       = data_iterator<data_vector, float>;
+    using const_iterator = data_iterator<const data_vector, const float>;
+    using value_type     = swr::data;
 
     std::string name;
+    size_t      start_year  = 0;
+    size_t      start_month = 1;
     vector_type data;
 
-    auto begin() {
-        return data.begin();
+    size_t year_of(size_t i) const {
+        return start_year + (start_month - 1 + i) / 12;
+    }
+
+    size_t month_of(size_t i) const {
+        return 1 + (start_month - 1 + i) % 12;
+    }
+
+    // Position of the given month in the series, only valid if the series contains it
+    size_t index_of(size_t year, size_t month) const {
+        return (year * 12 + month) - (start_year * 12 + start_month);
+    }
+
+    bool contains(size_t year, size_t month) const {
+        return month >= 1 && month <= 12 && year * 12 + month >= start_year * 12 + start_month && index_of(year, month) < data.size();
+    }
+
+    iterator begin() {
+        return {this, 0};
     }
-    auto begin() const {
-        return data.begin();
+    const_iterator begin() const {
+        return {this, 0};
     }
-    auto end() {
-        return data.end();
+    iterator end() {
+        return {this, data.size()};
     }
-    auto end() const {
-        return data.end();
+    const_iterator end() const {
+        return {this, data.size()};
     }
 
-    decltype(auto) front() const {
-        return data.front();
+    data_ref<const float> front() const {
+        return (*this)[0];
     }
 
-    decltype(auto) back() const {
-        return data.back();
+    data_ref<const float> back() const {
+        return (*this)[size() - 1];
     }
 
-    decltype(auto) operator[](size_t i) {
-        return data[i];
+    data_ref<float> operator[](size_t i) {
+        return {month_of(i), year_of(i), data[i]};
     }
-    decltype(auto) operator[](size_t i) const {
-        return data[i];
+    data_ref<const float> operator[](size_t i) const {
+        return {month_of(i), year_of(i), data[i]};
     }
 
     size_t size() const {
@@ -65,8 +227,46 @@ struct data_vector {
     }
 };
 
-using data_vector_iterator = data_vector::iterator;
+using data_vector_iterator       = data_vector::iterator;
+using data_vector_const_iterator = data_vector::const_iterator;
 
+// A prepared series (returns of an asset, inflation or exchange rates), shared by all its
+// users and never modified
+using shared_series = std::shared_ptr<const data_vector>;
+
+// The historical data of a scenario: the returns of the assets of its portfolio, the
+// inflation and the exchange rates of the assets. It is not modified once prepared, the
+// copies of a scenario share it instead of copying every series.
+struct market_data {
+    shared_series              inflation_data;
+    std::vector<shared_series> values;
+    std::vector<bool>          exchange_set;
+    std::vector<shared_series> exchange_rates; // Not set for the assets without exchange rates
+};
+
+// The prepared series are loaded and transformed once for the process and then shared
+// Returns an empty pointer (or vector) if the data cannot be loaded
+shared_series              shared_asset(const std::string& asset);
+std::vector<shared_series> shared_values(const std::vector<swr::allocation>& portfolio);
+shared_series              shared_inflation(const std::vector<shared_series>& values, const std::string& inflation);
+shared_series              shared_exchange(const std::string& exchange);
+shared_series              shared_exchange_inv(const std::string& exchange);
+
+// Prepare again all the series from the data files and publish them at once
+// The users of the previous series keep them until they are done. The series that cannot
+// be prepared again keep their previous data, in which case false is returned.
+bool reload_data();
+
+// Write the snapshot of the prepared series of all the data files (stock-data/snapshot.bin)
+// The series are then loaded from the snapshot, except the ones whose data file changed since
+// Returns the version of the data written (the hash of the snapshot), 0 on failure
+uint64_t write_snapshot();
+
+// The version of the data of the snapshot in use, 0 without snapshot or once a series
+// was prepared from its data file (changed since the snapshot) instead of the snapshot
+uint64_t data_version();
+
+// Copies of the prepared series, to be modified by the caller
 std::vector<data_vector> load_values(const std::vector<swr::allocation>& portfolio);
 std::vector<data_vector> load_adjusted_values(const std::vector<swr::allocation>& portfolio);
 data_vector              load_inflation(const std::vector<data_vector>& values, const std::string& inflation);
@@ -77,6 +277,8 @@ float                get_value(const data_vector& values, size_t year, size_t mo
 data_vector_iterator get_start(data_vector& values, size_t year, size_t month);
 data_vector_iterator get_start_hint(data_vector_iterator hint, data_vector& values, size_t year, size_t month);
 
+data_vector_const_iterator get_start(const data_vector& values, size_t year, size_t month);
+
 bool is_start_valid(const data_vector& values, size_t year, size_t month);
 
 } // namespace swr
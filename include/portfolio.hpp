@@ -15,15 +15,15 @@ namespace swr {
 struct allocation {
     std::string asset;
     float       allocation;
-
-    // Can be changed by the system
-    float allocation_;
 };
 
 std::vector<allocation> parse_portfolio(std::string_view portfolio_str, bool allow_zero);
 void                    normalize_portfolio(std::vector<allocation>& portfolio);
 float                   total_allocation(std::vector<allocation>& portfolio);
 
+// The allocations of a two-asset portfolio, from 0% to 100% of the first asset by step
+std::vector<std::vector<float>> allocation_grid(float step);
+
 std::ostream& operator<<(std::ostream& out, const std::vector<allocation>& portfolio);
 
 } // namespace swr
@@ -0,0 +1,40 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2019-2024.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace swr {
+
+// Counter-based random numbers (Philox4x32-10)
+//
+// The numbers of a path only depend on the seed, the stream and the index of
+// the path. The paths can therefore be generated in any order and on any
+// thread, they are always the same.
+struct random_paths {
+    uint64_t seed   = 0;
+    uint64_t stream = 0;
+
+    std::vector<uint32_t> bits; // Scratch space for the raw numbers
+
+    random_paths(uint64_t seed, uint64_t stream) : seed(seed), stream(stream) {}
+
+    // Fill values with n random 32-bit numbers of the given path
+    void uniforms(uint32_t* values, size_t n, uint64_t path);
+
+    // Fill values with n standard normal numbers of the given path
+    void normals(float* values, size_t n, uint64_t path);
+};
+
+// Replace each of the n values by its exponential
+// The values must be in [-87, 88], the range of exp in single precision
+void exp_inplace(float* values, size_t n);
+
+} // namespace swr
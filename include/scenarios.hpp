@@ -48,13 +48,40 @@ void multiple_wr_errors_graph(swr::Graph&                          graph,
                               float                                add_wr,
                               const std::map<float, swr::results>& base_results);
 
+// The same for each of the allocations of the portfolio, simulated together in one batch
+// Each allocation is one line, titled by the allocation
+void multiple_wr_success_graph(swr::Graph&                            graph,
+                               bool                                   shortForm,
+                               const swr::scenario&                   scenario,
+                               const std::vector<std::vector<float>>& allocations,
+                               float                                  start_wr,
+                               float                                  end_wr,
+                               float                                  add_wr);
+void multiple_wr_success_sheets(const swr::scenario& scenario, const std::vector<std::vector<float>>& allocations, float start_wr, float end_wr, float add_wr);
+void multiple_wr_withdrawn_graph(swr::Graph&                            graph,
+                                 bool                                   shortForm,
+                                 const swr::scenario&                   scenario,
+                                 const std::vector<std::vector<float>>& allocations,
+                                 float                                  start_wr,
+                                 float                                  end_wr,
+                                 float                                  add_wr);
+void multiple_wr_withdrawn_sheets(const swr::scenario& scenario, const std::vector<std::vector<float>>& allocations, float start_wr, float end_wr, float add_wr);
+void multiple_wr_duration_graph(swr::Graph&                            graph,
+                                bool                                   shortForm,
+                                const swr::scenario&                   scenario,
+                                const std::vector<std::vector<float>>& allocations,
+                                float                                  start_wr,
+                                float                                  end_wr,
+                                float                                  add_wr);
+void multiple_wr_duration_sheets(const swr::scenario& scenario, const std::vector<std::vector<float>>& allocations, float start_wr, float end_wr, float add_wr);
+
 void multiple_wr_spending_sheets(swr::scenario scenario, float start_wr, float end_wr, float add_wr);
 void multiple_wr_spending_trend_graph(swr::Graph& graph, swr::scenario scenario, float start_wr, float end_wr, float add_wr);
 void multiple_wr_spending_graph(swr::Graph& graph, swr::scenario scenario, float start_wr, float end_wr, float add_wr);
 
-float failsafe_swr_one(swr::scenario& scenario, float start_wr, float end_wr, float step, float goal);
-void  failsafe_swr(swr::scenario& scenario, float start_wr, float end_wr, float step, float goal, std::ostream& out);
-void  failsafe_swr(std::string_view title, swr::scenario& scenario, float start_wr, float end_wr, float step, std::ostream& out);
+float failsafe_swr_one(const swr::scenario& scenario, float start_wr, float end_wr, float step, float goal);
+void  failsafe_swr(const swr::scenario& scenario, float start_wr, float end_wr, float step, float goal, std::ostream& out);
+void  failsafe_swr(std::string_view title, const swr::scenario& scenario, float start_wr, float end_wr, float step, std::ostream& out);
 
 void multiple_wr_avg_tv_graph(swr::Graph& graph, std::string_view title, const swr::scenario& scenario, float start_wr, float end_wr, float add_wr);
 
@@ -72,4 +99,7 @@ std::string_view asset_to_blog_string(std::string_view asset);
 
 void configure_withdrawal_method(swr::scenario& scenario, std::vector<std::string> args, size_t n);
 
+// The default scenario of the commands, a simulation can use all the cores
+swr::scenario command_scenario();
+
 } // namespace swr
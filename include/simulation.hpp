@@ -9,9 +9,14 @@
 
 #include <vector>
 #include <cstdint>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 #include "portfolio.hpp"
 #include "data.hpp"
+#include "statistics.hpp"
 
 namespace swr {
 
@@ -39,6 +44,12 @@ enum class Flexibility : uint64_t {
     MARKET     // The strategy for being flexible when the the current market is in correction or bear market
 };
 
+enum class Statistics : uint64_t {
+    SUCCESS, // Only the success rate, durations and effective withdrawal rates
+    SUMMARY, // Also the distributions of the terminal values and of the spending
+    FULL     // Also the terminal value and the spending of each period
+};
+
 Rebalancing   parse_rebalance(const std::string& str);
 std::ostream& operator<<(std::ostream& out, const Rebalancing& rebalance);
 std::ostream& operator<<(std::ostream& out, const WithdrawalMethod& wmethod);
@@ -74,12 +85,27 @@ struct context {
     }
 };
 
+// Cooperative cancellation of a simulation
+// All the threads of the simulation stop at their next check once cancel() has
+// been called or once the condition (for instance a closed connection) is true
+struct cancellation_token {
+    std::atomic<bool>     cancelled = false;
+    std::function<bool()> condition; // Optional, polled by one thread at a time
+    std::mutex            lock;
+
+    void cancel() {
+        cancelled = true;
+    }
+
+    // Indicates if the simulation must stop
+    bool stop();
+};
+
 struct scenario {
     std::vector<swr::allocation> portfolio;
-    data_vector                  inflation_data;
-    std::vector<data_vector>     values;
-    std::vector<bool>            exchange_set;
-    std::vector<data_vector>     exchange_rates;
+
+    // The historical data, shared (and not copied) by the copies of the scenario
+    std::shared_ptr<const market_data> market;
 
     size_t              years;
     float               wr;
@@ -100,6 +126,18 @@ struct scenario {
     // By default, simulations can run for ever but the server will set that lower
     size_t timeout_msecs = 0;
 
+    // Optional token to cancel the simulation from the outside (shared by the copies of the scenario)
+    std::shared_ptr<cancellation_token> cancellation;
+
+    // By default, a simulation stopped by its timeout is an error. In anytime mode, the results
+    // of the simulations done so far are returned instead (backtesting then simulates the
+    // periods in a stratified order so that the periods done are spread over the whole range)
+    bool anytime = false;
+
+    // By default, a simulation runs on the calling thread, more threads can be used to
+    // split the periods of a single simulation (the results are the same)
+    size_t threads = 1;
+
     // Configuration for adding cash to the strategy
     float initial_cash = 0.0f;
     bool  cash_simple  = true;
@@ -140,18 +178,32 @@ struct scenario {
     bool   bootstrapping = false;
     size_t simulations   = 10000;
 
+    // Configuration for the random numbers of bootstrapping and Monte Carlo simulations
+    // The same seed and stream always give the same paths, whatever the number of threads
+    uint64_t seed   = 0;
+    uint64_t stream = 0;
+
     Simulation simulation        = Simulation::BACKTESTING;
     bool       strict_validation = true;
 
+    // The sweeps only need the success rate and can skip the distributions
+    // The distributions themselves are sketched in constant memory, only FULL
+    // keeps the values of each period
+    Statistics statistics = Statistics::FULL;
+
     bool is_failure(const context& context, float current_value) const {
+        return is_failure(context.end(), context.target_value_, current_value);
+    }
+
+    bool is_failure(bool end, float target_value, float current_value) const {
         // If it's not the end, we simply need to not run out of money
-        if (!context.end()) {
+        if (!end) {
             return current_value <= 0.0f;
         }
 
         // If it's the end, we need to respect the threshold
         if (final_inflation) {
-            return current_value <= final_threshold * context.target_value_;
+            return current_value <= final_threshold * target_value;
         }
 
         return current_value <= final_threshold * initial_value;
@@ -167,7 +219,13 @@ struct results {
     size_t flexible_successes = 0;
     size_t flexible_failures  = 0;
 
-    float success_rate = 0.0f;
+    float success_rate  = 0.0f;
+    float success_lower = 0.0f; // 95% confidence interval of the success rate
+    float success_upper = 0.0f;
+
+    // In anytime mode, the results may only cover a fraction of the simulations
+    bool  partial   = false;
+    float completed = 1.0f;
 
     float tv_average = 0.0f;
     float tv_minimum = 0.0f;
@@ -210,11 +268,16 @@ struct results {
     std::string message;
     bool        error = false;
 
-    std::vector<float> terminal_values;
-    std::vector<float> flexible;
-    void               compute_terminal_values(std::vector<float> terminal_values);
-    void               compute_spending(std::vector<std::vector<float>>& terminal_values, size_t years);
+    // Distributions of the terminal values and of the spending of the periods
+    streaming_statistics tv_statistics;
+    streaming_statistics spending_statistics;
 
+    void compute_success_interval();
+    void compute_terminal_values();
+    void compute_spending(size_t years);
+
+    std::vector<float>              terminal_values;
+    std::vector<float>              flexible;
     std::vector<std::vector<float>> spending;
 
     void record_failure(size_t months, size_t current_month, size_t current_year) {
@@ -226,7 +289,67 @@ struct results {
     }
 };
 
-results simulation(scenario& scenario);
+// The scenario is not modified, it can be simulated by several threads at once
+results simulation(const scenario& scenario);
+
+// Simulate the scenario with each of the withdrawal rates (scenario.wr is not used)
+// The rates are simulated together, in one pass over the periods, the results are the
+// same as the ones of a simulation with each rate
+std::vector<results> simulation(const scenario& scenario, const std::vector<float>& rates);
+
+// Simulate the scenario with each of the allocations (one percentage per asset of the portfolio)
+// The allocations are simulated together, in one pass over the periods, like the rates above
+std::vector<results> simulation(const scenario& scenario, const std::vector<std::vector<float>>& allocations);
+
+// Simulate the scenario with each of the allocations and each of the rates, in one pass
+// The results are by allocation, the result of allocations[a] and rates[r] is at a * rates.size() + r
+std::vector<results> simulation(const scenario& scenario, const std::vector<std::vector<float>>& allocations, const std::vector<float>& rates);
+
+// The parts of a prepared scenario that depend neither on the withdrawal rate nor on the
+// allocation: the series, the kernel and the cumulative indices (internal to the simulation)
+struct plan_state;
+
+// A scenario validated and prepared once, to be simulated many times
+// The period is adapted to the data, the series are located (and fused with the exchange
+// rates) and the kernel is selected. Only the withdrawal rate and the allocation of the
+// portfolio can change between the simulations of a plan. A plan is not modified by its
+// simulations and can be shared by several threads.
+struct simulation_plan {
+    scenario resolved;   // The scenario, with its period adapted to the data
+    results  validation; // The messages of the validation, with the error if the scenario is invalid
+
+    std::shared_ptr<const plan_state> state; // Not set if the scenario is invalid
+};
+
+simulation_plan prepare(const scenario& scenario);
+
+// Simulate the plan, with the rate and the allocation of its scenario or with the given rate
+results simulation(const simulation_plan& plan);
+results simulation(const simulation_plan& plan, float wr);
+
+// Simulate the plan with each of the rates, or each of the allocations and each of the rates
+// The results are in the same order as the ones of the scenario overloads
+std::vector<results> simulation(const simulation_plan& plan, const std::vector<float>& rates);
+std::vector<results> simulation(const simulation_plan& plan, const std::vector<std::vector<float>>& allocations, const std::vector<float>& rates);
+
+// The highest successful withdrawal rate of each start period of a backtesting
+struct critical_rates {
+    std::vector<float>  grid;    // The candidate withdrawal rates, from the highest
+    std::vector<size_t> periods; // For each start period, index of its highest successful rate (grid.size() if none)
+
+    std::string message;
+    bool        error = false;
+
+    // Index of the highest rate with a success rate of at least (100 - goal)% (grid.size() if none)
+    size_t failsafe(float goal) const;
+};
+
+// Indicates if the success of a period is monotone in the withdrawal rate for this scenario
+bool critical_rates_supported(const scenario& scenario);
+
+// Compute the critical rates among the rates from start_wr down to end_wr by step
+critical_rates critical_withdrawal_rates(const scenario& scenario, float start_wr, float end_wr, float step);
+critical_rates critical_withdrawal_rates(const simulation_plan& plan, float start_wr, float end_wr, float step);
 
 size_t simulations_ran();
 
@@ -0,0 +1,85 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2019-2024.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace swr {
+
+// Mergeable quantile sketch (a deterministic variant of KLL)
+//
+// The values are kept exactly until a level holds more than 2 * capacity of them. The
+// level is then sorted and every other value is promoted to the next level
+// with twice the weight. The memory only grows with log(n / capacity) and the
+// rank error stays around log(n / capacity) / capacity.
+struct quantile_sketch {
+    size_t capacity = 16384;
+    size_t count    = 0;
+
+    std::vector<std::vector<float>> levels;      // A value of level h stands for 2^h values
+    std::vector<size_t>             compactions; // Number of compactions of each level
+
+    void push(float value) {
+        if (levels.empty()) {
+            levels.emplace_back();
+            compactions.push_back(0);
+        }
+
+        levels[0].push_back(value);
+        ++count;
+
+        if (levels[0].size() > 2 * capacity) {
+            compact(0);
+        }
+    }
+
+    // Indicates if all the values are still kept
+    bool exact() const {
+        return levels.size() <= 1;
+    }
+
+    void merge(const quantile_sketch& rhs);
+
+    // The value of the given rank (from 0) in the sorted values
+    float at(size_t rank) const;
+
+    // The value at the given quantile ([0, 1]) of the values
+    float quantile(float q) const;
+
+private:
+    void compact(size_t level);
+};
+
+// Exact count, mean, minimum and maximum with a quantile sketch of the values
+struct streaming_statistics {
+    size_t count   = 0;
+    double sum     = 0.0;
+    float  minimum = 0.0f;
+    float  maximum = 0.0f;
+
+    quantile_sketch sketch;
+
+    void push(float value) {
+        minimum = count ? std::min(minimum, value) : value;
+        maximum = count ? std::max(maximum, value) : value;
+        sum += value;
+        ++count;
+
+        sketch.push(value);
+    }
+
+    void merge(const streaming_statistics& rhs);
+
+    float mean() const {
+        return count ? static_cast<float>(sum / count) : 0.0f;
+    }
+};
+
+} // namespace swr
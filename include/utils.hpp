@@ -9,6 +9,7 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 
 #include "portfolio.hpp"
 #include "data.hpp"
@@ -18,7 +19,13 @@ namespace swr {
 
 std::vector<std::string> parse_args(int argc, const char* argv[]);
 
-bool prepare_exchange_rates(swr::scenario& scenario, const std::string& currency);
+bool prepare_exchange_rates(swr::market_data& market, const std::vector<swr::allocation>& portfolio, const std::string& currency);
+
+// Load the returns of the portfolio, the inflation and the exchange rates to the currency
+// On error, nothing is returned
+std::shared_ptr<const swr::market_data> load_market_data(const std::vector<swr::allocation>& portfolio,
+                                                         const std::string&                  inflation,
+                                                         const std::string&                  currency);
 
 float percentile(const std::vector<float>& v, size_t p);
 
@@ -5,32 +5,116 @@
 //  http://opensource.org/licenses/MIT)
 //=======================================================================
 
-#include <fstream>
 #include <iostream>
 #include <algorithm>
-#include <sstream>
 #include <unordered_map>
 #include <mutex>
+#include <atomic>
+#include <memory>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "data.hpp"
 
 namespace {
 
-std::mutex server_lock;
+// A read-only mapping of a whole file
+struct mapped_file {
+    const char* data = nullptr;
+    size_t      size = 0;
 
-std::unordered_map<std::string, swr::data_vector> data_cache;
+    explicit mapped_file(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
 
-swr::data_vector load_data(const std::string& name, const std::string& path) {
-    {
-        const std::unique_lock l(server_lock);
-        if (data_cache.contains(name)) {
-            return data_cache[name];
+        if (fd < 0) {
+            return;
+        }
+
+        struct stat st{};
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* ptr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (ptr != MAP_FAILED) {
+                data = static_cast<const char*>(ptr);
+                size = st.st_size;
+            }
+        }
+
+        // The mapping stays valid once the file is closed
+        ::close(fd);
+    }
+
+    mapped_file(const mapped_file&)            = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    ~mapped_file() {
+        if (data) {
+            ::munmap(const_cast<char*>(data), size);
         }
     }
 
+    explicit operator bool() const {
+        return data != nullptr;
+    }
+};
+
+// Parse an integer field, followed by a comma
+bool parse_field(const char*& it, const char* end, size_t& value) {
+    auto [ptr, ec] = std::from_chars(it, end, value);
+
+    if (ec != std::errc{} || ptr == end || *ptr != ',') {
+        return false;
+    }
+
+    it = ptr + 1;
+    return true;
+}
+
+// Parse the last field of a line, the value can be quoted with thousands separators ("1,234.56")
+bool parse_value(const char* it, const char* end, float& value) {
+    if (it != end && *it == '"') {
+        std::array<char, 64> digits;
+        size_t               n = 0;
+
+        for (++it; it != end && *it != '"'; ++it) {
+            if (*it != ',') {
+                if (n == digits.size()) {
+                    return false;
+                }
+
+                digits[n++] = *it;
+            }
+        }
+
+        // The closing quote must end the line
+        if (it == end || it + 1 != end) {
+            return false;
+        }
+
+        auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + n, value);
+        return ec == std::errc{} && ptr == digits.data() + n;
+    }
+
+    auto [ptr, ec] = std::from_chars(it, end, value);
+    return ec == std::errc{} && ptr == end;
+}
+
+// Load the monthly points of a file (month,year,value on each line) in a single pass
+swr::data_vector load_data(const std::string& name, const std::string& path) {
     swr::data_vector points;
 
-    std::ifstream file(path);
+    const mapped_file file(path);
 
     if (!file) {
         std::cout << "Impossible to load data " << path << "\n";
@@ -39,32 +123,58 @@ swr::data_vector load_data(const std::string& name, const std::string& path) {
 
     points.name = name;
 
-    std::string line;
-    while (std::getline(file, line)) {
-        auto index1 = line.find(',');
-        auto index2 = line.find(',', index1 + 1);
+    const char* it  = file.data;
+    const char* end = file.data + file.size;
+
+    // One point by line, the gaps are rare
+    points.data.reserve(std::count(it, end, '\n') + 1);
 
-        const std::string month(line.begin(), line.begin() + index1);
-        const std::string year(line.begin() + index1 + 1, line.begin() + index2);
-        std::string       value(line.begin() + index2 + 1, line.end());
+    for (size_t line = 1; it != end; ++line) {
+        const char* line_end = static_cast<const char*>(std::memchr(it, '\n', end - it));
+        const char* next     = line_end ? line_end + 1 : end;
 
-        if (value[0] == '\"') {
-            value = value.substr(1, value.size() - 3);
+        if (!line_end) {
+            line_end = end;
         }
 
-        std::erase(value, ',');
+        if (line_end != it && line_end[-1] == '\r') {
+            --line_end;
+        }
+
+        // Empty lines are ignored
+        if (line_end == it) {
+            it = next;
+            continue;
+        }
 
         swr::data data{};
-        data.month = atoi(month.c_str());
-        data.year  = atoi(year.c_str());
-        data.value = atof(value.c_str());
 
-        points.data.push_back(data);
-    }
+        if (!parse_field(it, line_end, data.month) || !parse_field(it, line_end, data.year) || !parse_value(it, line_end, data.value)) {
+            std::cout << "Invalid line " << line << " in data " << path << "\n";
+            return {};
+        }
 
-    {
-        const std::unique_lock l(server_lock);
-        data_cache[name] = points;
+        it = next;
+
+        // The months must be valid and increasing for the lookups to be computed from the position
+        const bool ordered = points.empty() || data.year * 12 + data.month >= points.start_year * 12 + points.start_month + points.size();
+        if (data.month < 1 || data.month > 12 || !ordered) {
+            std::cout << "Invalid date " << data.year << "/" << data.month << " at line " << line << " in data " << path << "\n";
+            return {};
+        }
+
+        if (points.empty()) {
+            points.start_year  = data.year;
+            points.start_month = data.month;
+        }
+
+        // The series is dense, a missing month keeps the previous value
+        const size_t index = points.index_of(data.year, data.month);
+        while (points.size() < index) {
+            points.data.push_back(points.data.back());
+        }
+
+        points.data.push_back(data.value);
     }
 
     return points;
@@ -72,198 +182,621 @@ swr::data_vector load_data(const std::string& name, const std::string& path) {
 
 // Make sure that the data ends with a full year
 void fix_end(swr::data_vector& values) {
-    while (values.data.back().month != 12) {
+    while (values.back().month != 12) {
         values.data.pop_back();
     }
 }
 
 // Make sure that the data starts with a full year
 void fix_start(swr::data_vector& values) {
-    while (values.data.front().month != 1) {
-        values.data.erase(values.data.begin());
+    size_t skip = 0;
+    while (values.month_of(skip) != 1) {
+        ++skip;
     }
+
+    values.start_year  = values.year_of(skip);
+    values.start_month = 1;
+    values.data.erase(values.data.begin(), values.data.begin() + skip);
 }
 
 void normalize_data(swr::data_vector& values) {
     fix_end(values);
     fix_start(values);
 
-    if (values.data.front().value == 1.0f) {
+    auto& data = values.data;
+
+    if (data.front() == 1.0f) {
         return;
     }
 
-    auto previous_value = values[0].value;
-    values[0].value     = 1.0f;
+    auto previous_value = data[0];
+    data[0]             = 1.0f;
 
-    for (size_t i = 1; i < values.size(); ++i) {
-        auto value      = values[i].value;
-        values[i].value = values[i - 1].value * (value / previous_value);
-        previous_value  = value;
+    for (size_t i = 1; i < data.size(); ++i) {
+        auto value     = data[i];
+        data[i]        = data[i - 1] * (value / previous_value);
+        previous_value = value;
     }
 }
 
 void transform_to_returns(swr::data_vector& values) {
+    auto& data = values.data;
+
     // Should already be normalized
-    float previous_value = values[0].value;
+    float previous_value = data[0];
 
-    for (size_t i = 1; i < values.size(); ++i) {
-        auto new_value  = values[i].value / previous_value;
-        previous_value  = values[i].value;
-        values[i].value = new_value;
+    for (size_t i = 1; i < data.size(); ++i) {
+        auto new_value = data[i] / previous_value;
+        previous_value = data[i];
+        data[i]        = new_value;
     }
 }
 
-} // end of anonymous namespace
+// The source of a series, to detect the stale series of the snapshot
+struct source_stamp {
+    uint64_t size  = 0;
+    int64_t  mtime = 0; // In nanoseconds
 
-std::vector<swr::data_vector> swr::load_adjusted_values(const std::vector<swr::allocation>& portfolio) {
-    auto values = load_values(portfolio);
+    bool operator==(const source_stamp& rhs) const = default;
+};
 
-    for (size_t i = 0; i < values.size(); ++i) {
-        if (portfolio[i].asset == "us_bonds") {
-            for (auto& v : values[i]) {
-                v.value -= 0.25f / 100.0f;
-            }
-        }
+bool stamp_of(const std::string& path, source_stamp& stamp) {
+    struct stat st{};
+    if (::stat(path.c_str(), &st) != 0) {
+        return false;
     }
 
-    return values;
+    stamp.size  = st.st_size;
+    stamp.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec;
+    return true;
 }
 
-std::vector<swr::data_vector> swr::load_values(const std::vector<swr::allocation>& portfolio) {
-    std::vector<swr::data_vector> values;
+std::string data_path(const std::string& filename) {
+    return "stock-data/" + filename + ".csv";
+}
 
-    for (const auto& asset : portfolio) {
-        const auto& asset_name = asset.asset;
+// The binary snapshot of the prepared series of all the data files
+// Layout: the header, the entries and then the values of all the series
+const std::string  snapshot_path     = "stock-data/snapshot.bin";
+constexpr char     snapshot_magic[8] = {'S', 'W', 'R', 'D', 'A', 'T', 'A', '\0'};
+constexpr uint32_t snapshot_version  = 1;
+
+struct snapshot_header {
+    char     magic[8];
+    uint32_t version; // Incremented with each change of the layout
+    uint32_t count;   // Number of entries
+    uint64_t hash;    // Hash of everything after the header, also the version of the data
+};
+
+// The data files of the exchange rates, the only ones also inverted in the snapshot
+constexpr std::array<std::string_view, 1> exchange_files = {"usd_chf"};
+
+struct snapshot_entry {
+    char         key[56];     // "returns/<file>" or "inverse/<exchange file>"
+    uint32_t     start_year;
+    uint32_t     start_month;
+    uint64_t     offset;      // Position of the first value, in values
+    uint64_t     size;        // Number of values
+    source_stamp source;      // The data file the series was prepared from
+};
+
+static_assert(std::is_trivially_copyable_v<snapshot_header> && std::is_trivially_copyable_v<snapshot_entry>);
+
+// FNV-1a
+uint64_t snapshot_hash(const char* data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
 
-        const bool x2 = asset_name.ends_with("_x2");
-        const bool l2 = asset_name.ends_with("_l2");
-        const bool l3 = asset_name.ends_with("_l3");
+    return hash;
+}
+
+struct snapshot {
+    std::unique_ptr<mapped_file> file;
+    snapshot_header              header{};
+    const char*                  entries = nullptr;
+    const char*                  values  = nullptr;
 
-        std::string filename = asset_name;
+    // Set once a series had to be prepared from its data file instead, the hash
+    // of the snapshot is then no longer the version of the data in use
+    mutable std::atomic<bool> stale = false;
+
+    snapshot_entry entry(size_t i) const {
+        snapshot_entry entry;
+        std::memcpy(&entry, entries + i * sizeof(snapshot_entry), sizeof(snapshot_entry));
+        return entry;
+    }
 
-        if (x2 || l2 || l3) {
-            filename = std::string(asset_name.begin(), asset_name.end() - 3);
+    // Returns the series with the given key, only if its data file did not change since
+    bool find(const std::string& key, const std::string& filename, swr::data_vector& series) const {
+        for (size_t i = 0; i < header.count; ++i) {
+            const auto e = entry(i);
+
+            if (key != std::string_view(e.key, strnlen(e.key, sizeof(e.key)))) {
+                continue;
+            }
+
+            source_stamp stamp;
+            if (!stamp_of(data_path(filename), stamp) || stamp != e.source) {
+                return false;
+            }
+
+            series.name        = filename;
+            series.start_year  = e.start_year;
+            series.start_month = e.start_month;
+            series.data.resize(e.size);
+            std::memcpy(series.data.data(), values + e.offset * sizeof(float), e.size * sizeof(float));
+
+            return true;
         }
 
-        auto data = load_data(filename, "stock-data/" + filename + ".csv");
+        return false;
+    }
+};
 
-        if (data.empty()) {
-            std::cout << "Impossible to load data for asset " << asset_name << "\n";
+// Returns an empty pointer if there is no (valid) snapshot
+std::shared_ptr<const snapshot> open_snapshot() {
+    auto file = std::make_unique<mapped_file>(snapshot_path);
+
+    if (!*file) {
+        return {};
+    }
+
+    auto snap = std::make_shared<snapshot>();
+
+    if (file->size < sizeof(snapshot_header)) {
+        std::cout << "Invalid snapshot " << snapshot_path << ", the data files are used\n";
+        return {};
+    }
+
+    std::memcpy(&snap->header, file->data, sizeof(snapshot_header));
+
+    const auto& header = snap->header;
+
+    if (std::memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)) != 0 || header.version != snapshot_version) {
+        std::cout << "Unsupported snapshot " << snapshot_path << ", the data files are used\n";
+        return {};
+    }
+
+    const size_t entries_size = header.count * sizeof(snapshot_entry);
+    const size_t content_size = file->size - sizeof(snapshot_header);
+
+    if (content_size < entries_size || snapshot_hash(file->data + sizeof(snapshot_header), content_size) != header.hash) {
+        std::cout << "Corrupted snapshot " << snapshot_path << ", the data files are used\n";
+        return {};
+    }
+
+    snap->entries = file->data + sizeof(snapshot_header);
+    snap->values  = snap->entries + entries_size;
+
+    const size_t values = (content_size - entries_size) / sizeof(float);
+
+    for (size_t i = 0; i < header.count; ++i) {
+        const auto e = snap->entry(i);
+
+        if (e.offset > values || e.size > values - e.offset || e.start_month < 1 || e.start_month > 12) {
+            std::cout << "Corrupted snapshot " << snapshot_path << ", the data files are used\n";
             return {};
         }
+    }
+
+    snap->file = std::move(file);
 
-        normalize_data(data);
-        transform_to_returns(data);
+    return snap;
+}
 
-        if (x2) {
-            auto copy = data;
-            std::ranges::copy(copy, std::back_inserter(data.data));
+// The snapshot in use, opened with the first series and again with each reload
+std::atomic<std::shared_ptr<const snapshot>> snapshot_store;
+std::once_flag                               snapshot_once;
 
-            for (size_t i = 0; i < copy.size(); ++i) {
-                const size_t j    = copy.size() - 1 - i;
-                auto&        curr = data[j];
-                const auto&  prev = data[j + 1];
+std::shared_ptr<const snapshot> current_snapshot() {
+    std::call_once(snapshot_once, []() { snapshot_store.store(open_snapshot()); });
+    return snapshot_store.load();
+}
 
-                if (prev.month == 1) {
-                    curr.month = 12;
-                    curr.year  = prev.year - 1;
-                } else {
-                    curr.month = prev.month - 1;
-                    curr.year  = prev.year;
-                }
-            }
-        } else if (l2 || l3) {
-            for (auto& d : data) {
-                auto ret = d.value - 1.0f;
-                ret *= l2 ? 2.0f : 3.0f;
-                d.value = 1.0f + ret;
+// Prepare the returns of a data file, from the snapshot if it is up to date
+swr::data_vector prepare_returns(const std::string& filename, bool inverse, bool use_snapshot = true) {
+    if (use_snapshot) {
+        if (auto snap = current_snapshot()) {
+            swr::data_vector series;
+            if (snap->find((inverse ? "inverse/" : "returns/") + filename, filename, series)) {
+                return series;
             }
+
+            snap->stale = true;
         }
+    }
+
+    auto data = load_data(filename, data_path(filename));
 
-        values.emplace_back(std::move(data));
+    if (data.empty()) {
+        return {};
     }
 
-    return values;
+    // Invert the exchange rate
+    if (inverse) {
+        for (auto& v : data.data) {
+            v = 1.0f / v;
+        }
+    }
+
+    normalize_data(data);
+    transform_to_returns(data);
+
+    return data;
 }
 
-swr::data_vector swr::load_inflation(const std::vector<swr::data_vector>& values, const std::string& inflation) {
-    swr::data_vector inflation_data;
+swr::data_vector prepare_asset(const std::string& asset_name) {
+    const bool x2 = asset_name.ends_with("_x2");
+    const bool l2 = asset_name.ends_with("_l2");
+    const bool l3 = asset_name.ends_with("_l3");
 
-    if (inflation == "no_inflation") {
-        inflation_data = values.front();
+    std::string filename = asset_name;
 
-        for (auto& value : inflation_data) {
-            value.value = 1;
-        }
-    } else {
-        inflation_data = load_data(inflation, "stock-data/" + inflation + ".csv");
+    if (x2 || l2 || l3) {
+        filename = std::string(asset_name.begin(), asset_name.end() - 3);
+    }
 
-        if (inflation_data.empty()) {
-            std::cout << "Impossible to load inflation data for asset " << inflation << "\n";
-            return {};
+    auto data = prepare_returns(filename, false);
+
+    if (data.empty()) {
+        std::cout << "Impossible to load data for asset " << asset_name << "\n";
+        return {};
+    }
+
+    // The derived series do not have the period of their data
+    data.name = asset_name;
+
+    if (x2) {
+        // The history is played twice, the first time ending just before the real data starts
+        const auto   copy  = data.data;
+        const size_t start = data.start_year * 12 + (data.start_month - 1) - copy.size();
+
+        data.data.insert(data.data.begin(), copy.begin(), copy.end());
+
+        data.start_year  = start / 12;
+        data.start_month = 1 + start % 12;
+    } else if (l2 || l3) {
+        for (auto& value : data.data) {
+            auto ret = value - 1.0f;
+            ret *= l2 ? 2.0f : 3.0f;
+            value = 1.0f + ret;
         }
+    }
+
+    return data;
+}
+
+swr::data_vector prepare_inflation(const std::string& inflation) {
+    auto inflation_data = prepare_returns(inflation, false);
 
-        normalize_data(inflation_data);
-        transform_to_returns(inflation_data);
+    if (inflation_data.empty()) {
+        std::cout << "Impossible to load inflation data for asset " << inflation << "\n";
+        return {};
     }
 
     return inflation_data;
 }
 
-swr::data_vector swr::load_exchange(const std::string& exchange) {
-    auto exchange_data = load_data(exchange, "stock-data/" + exchange + ".csv");
+swr::data_vector prepare_exchange(const std::string& exchange, bool inverse) {
+    auto exchange_data = prepare_returns(exchange, inverse);
 
     if (exchange_data.empty()) {
         std::cout << "Impossible to load exchange data for " << exchange << "\n";
         return {};
     }
 
-    normalize_data(exchange_data);
-    transform_to_returns(exchange_data);
-
     return exchange_data;
 }
 
-swr::data_vector swr::load_exchange_inv(const std::string& exchange) {
-    auto exchange_data = load_data(exchange, "stock-data/" + exchange + ".csv");
+// Prepare the series with the given key ("<kind>/<name>") from the data files
+swr::data_vector prepare_series(const std::string& key) {
+    const auto        separator = key.find('/');
+    const std::string kind(key.begin(), key.begin() + separator);
+    const std::string name(key.begin() + separator + 1, key.end());
+
+    if (kind == "asset") {
+        return prepare_asset(name);
+    } else if (kind == "inflation") {
+        return prepare_inflation(name);
+    } else if (kind == "exchange") {
+        return prepare_exchange(name, false);
+    } else if (kind == "exchange_inv") {
+        return prepare_exchange(name, true);
+    } else if (kind == "no_inflation") {
+        // The series has the same period as the asset
+        auto inflation_data = prepare_asset(name);
+        std::ranges::fill(inflation_data.data, 1.0f);
+        return inflation_data;
+    }
 
-    if (exchange_data.empty()) {
-        std::cout << "Impossible to load exchange data for " << exchange << "\n";
+    std::cout << "This should not happen (invalid series " << key << ")\n";
+
+    return {};
+}
+
+// The prepared series of the process, by key. The map is never modified once published,
+// a new series publishes a new map, the readers do not need any lock
+using series_map = std::unordered_map<std::string, swr::shared_series>;
+
+std::atomic<std::shared_ptr<const series_map>> series_store{std::make_shared<const series_map>()};
+
+// Only the preparation of new series is serialized
+std::mutex store_lock;
+
+// Only one reload at a time
+std::mutex reload_lock;
+
+// Returns the series with the given key, prepared the first time it is needed
+swr::shared_series prepared_series(const std::string& key) {
+    if (auto store = series_store.load(); store->contains(key)) {
+        return store->at(key);
+    }
+
+    const std::unique_lock l(store_lock);
+
+    // The series may have been prepared while waiting for the lock
+    auto store = series_store.load();
+    if (store->contains(key)) {
+        return store->at(key);
+    }
+
+    auto data = prepare_series(key);
+
+    // The failures are not kept, the data may be fixed later
+    if (data.empty()) {
         return {};
     }
 
-    // Invert the exchange rate
-    for (auto& v : exchange_data) {
-        v.value = 1.0f / v.value;
+    auto series = std::make_shared<const swr::data_vector>(std::move(data));
+
+    auto next = std::make_shared<series_map>(*store);
+    next->emplace(key, series);
+    series_store.store(std::move(next));
+
+    return series;
+}
+
+} // end of anonymous namespace
+
+swr::shared_series swr::shared_asset(const std::string& asset) {
+    return prepared_series("asset/" + asset);
+}
+
+std::vector<swr::shared_series> swr::shared_values(const std::vector<swr::allocation>& portfolio) {
+    std::vector<swr::shared_series> values;
+
+    for (const auto& asset : portfolio) {
+        auto series = shared_asset(asset.asset);
+
+        if (!series) {
+            return {};
+        }
+
+        values.emplace_back(std::move(series));
     }
 
-    normalize_data(exchange_data);
-    transform_to_returns(exchange_data);
+    return values;
+}
 
-    return exchange_data;
+swr::shared_series swr::shared_inflation(const std::vector<shared_series>& values, const std::string& inflation) {
+    if (inflation == "no_inflation") {
+        // The series has the same period as the first asset
+        return prepared_series("no_inflation/" + values.front()->name);
+    }
+
+    return prepared_series("inflation/" + inflation);
 }
 
-float swr::get_value(const swr::data_vector& values, size_t year, size_t month) {
-    for (const auto& data : values) {
-        if (data.year == year && data.month == month) {
-            return data.value;
+swr::shared_series swr::shared_exchange(const std::string& exchange) {
+    return prepared_series("exchange/" + exchange);
+}
+
+swr::shared_series swr::shared_exchange_inv(const std::string& exchange) {
+    return prepared_series("exchange_inv/" + exchange);
+}
+
+bool swr::reload_data() {
+    const std::unique_lock reload(reload_lock);
+
+    // The snapshot may have been written again with the data files
+    current_snapshot();
+    snapshot_store.store(open_snapshot());
+
+    // The new series are prepared without blocking the readers nor the new series
+    auto store    = series_store.load();
+    bool complete = true;
+
+    series_map next;
+
+    for (const auto& [key, series] : *store) {
+        auto data = prepare_series(key);
+
+        if (data.empty()) {
+            std::cout << "Impossible to reload " << key << ", the previous data is kept\n";
+            next.emplace(key, series);
+            complete = false;
+            continue;
         }
+
+        next.emplace(key, std::make_shared<const swr::data_vector>(std::move(data)));
     }
 
-    std::cout << "This should not happen (value out of range)\n";
+    {
+        const std::unique_lock l(store_lock);
 
-    return 0.0f;
+        // The series prepared during the reload are already from the new files
+        for (const auto& [key, series] : *series_store.load()) {
+            next.try_emplace(key, series);
+        }
+
+        series_store.store(std::make_shared<const series_map>(std::move(next)));
+    }
+
+    // The previous data kept for some series may not be the one of the snapshot
+    if (auto snap = current_snapshot(); snap && !complete) {
+        snap->stale = true;
+    }
+
+    return complete;
 }
 
-swr::data_vector_iterator swr::get_start_hint(data_vector_iterator hint, swr::data_vector& values, size_t year, size_t month) {
-    auto end = values.end();
+uint64_t swr::write_snapshot() {
+    std::vector<snapshot_entry> entries;
+    std::vector<float>          values;
+    std::vector<std::string>    files;
 
-    while (hint != end) {
-        if (hint->year == year && hint->month == month) {
-            return hint;
+    std::error_code error;
+    for (const auto& file : std::filesystem::directory_iterator("stock-data", error)) {
+        if (file.path().extension() == ".csv") {
+            files.push_back(file.path().stem().string());
         }
+    }
 
-        ++hint;
+    if (error || files.empty()) {
+        std::cout << "Impossible to list the data files\n";
+        return 0;
+    }
+
+    std::ranges::sort(files);
+
+    for (const auto& filename : files) {
+        for (bool inverse : {false, true}) {
+            if (inverse && std::ranges::find(exchange_files, filename) == exchange_files.end()) {
+                continue;
+            }
+
+            snapshot_entry entry{};
+
+            const std::string key = (inverse ? "inverse/" : "returns/") + filename;
+
+            if (key.size() >= sizeof(entry.key)) {
+                std::cout << "The name of the data file " << filename << " is too long for the snapshot\n";
+                return 0;
+            }
+
+            // The stamp is taken first, a change during the preparation makes the series stale
+            if (!stamp_of(data_path(filename), entry.source)) {
+                std::cout << "Impossible to load data " << data_path(filename) << "\n";
+                return 0;
+            }
+
+            // The snapshot is always prepared from the data files
+            auto series = prepare_returns(filename, inverse, false);
+
+            if (series.empty()) {
+                return 0;
+            }
+
+            std::ranges::copy(key, entry.key);
+            entry.start_year  = series.start_year;
+            entry.start_month = series.start_month;
+            entry.offset      = values.size();
+            entry.size        = series.size();
+
+            values.insert(values.end(), series.data.begin(), series.data.end());
+            entries.push_back(entry);
+        }
+    }
+
+    snapshot_header header{};
+    std::ranges::copy(snapshot_magic, header.magic);
+    header.version = snapshot_version;
+    header.count   = entries.size();
+    header.hash    = snapshot_hash(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(snapshot_entry));
+    header.hash    = snapshot_hash(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float), header.hash);
+
+    // The snapshot replaces the previous one at once, the processes using it keep their mapping
+    const std::string temporary = snapshot_path + ".tmp";
+
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(snapshot_entry));
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+
+        if (!out) {
+            std::cout << "Impossible to write the snapshot " << temporary << "\n";
+            return 0;
+        }
+    }
+
+    std::filesystem::rename(temporary, snapshot_path, error);
+
+    if (error) {
+        std::cout << "Impossible to write the snapshot " << snapshot_path << "\n";
+        return 0;
+    }
+
+    return header.hash;
+}
+
+uint64_t swr::data_version() {
+    auto snap = current_snapshot();
+    return snap && !snap->stale ? snap->header.hash : 0;
+}
+
+std::vector<swr::data_vector> swr::load_adjusted_values(const std::vector<swr::allocation>& portfolio) {
+    auto values = load_values(portfolio);
+
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (portfolio[i].asset == "us_bonds") {
+            for (auto& v : values[i].data) {
+                v -= 0.25f / 100.0f;
+            }
+        }
+    }
+
+    return values;
+}
+
+std::vector<swr::data_vector> swr::load_values(const std::vector<swr::allocation>& portfolio) {
+    std::vector<swr::data_vector> values;
+
+    for (const auto& series : shared_values(portfolio)) {
+        values.push_back(*series);
+    }
+
+    return values;
+}
+
+swr::data_vector swr::load_inflation(const std::vector<swr::data_vector>& values, const std::string& inflation) {
+    if (inflation == "no_inflation") {
+        swr::data_vector inflation_data = values.front();
+        std::ranges::fill(inflation_data.data, 1.0f);
+        return inflation_data;
+    }
+
+    auto series = prepared_series("inflation/" + inflation);
+    return series ? *series : swr::data_vector{};
+}
+
+swr::data_vector swr::load_exchange(const std::string& exchange) {
+    auto series = shared_exchange(exchange);
+    return series ? *series : swr::data_vector{};
+}
+
+swr::data_vector swr::load_exchange_inv(const std::string& exchange) {
+    auto series = shared_exchange_inv(exchange);
+    return series ? *series : swr::data_vector{};
+}
+
+float swr::get_value(const swr::data_vector& values, size_t year, size_t month) {
+    if (values.contains(year, month)) {
+        return values.data[values.index_of(year, month)];
+    }
+
+    std::cout << "This should not happen (value out of range)\n";
+
+    return 0.0f;
+}
+
+swr::data_vector_iterator swr::get_start_hint(data_vector_iterator hint, swr::data_vector& values, size_t year, size_t month) {
+    // The hint can only be before the start
+    if (values.contains(year, month) && values.index_of(year, month) >= hint.index) {
+        return {&values, values.index_of(year, month)};
     }
 
     std::cout << "This should not happen (start out of range) " << year << "/" << month << "\n";
@@ -275,17 +808,16 @@ swr::data_vector_iterator swr::get_start(swr::data_vector& values, size_t year,
     return get_start_hint(values.begin(), values, year, month);
 }
 
-bool swr::is_start_valid(const swr::data_vector& values, size_t year, size_t month) {
-    auto it  = values.begin();
-    auto end = values.end();
+swr::data_vector_const_iterator swr::get_start(const swr::data_vector& values, size_t year, size_t month) {
+    if (values.contains(year, month)) {
+        return {&values, values.index_of(year, month)};
+    }
 
-    while (it != end) {
-        if (it->year == year && it->month == month) {
-            return true;
-        }
+    std::cout << "This should not happen (start out of range) " << year << "/" << month << "\n";
 
-        ++it;
-    }
+    return values.begin();
+}
 
-    return false;
+bool swr::is_start_valid(const swr::data_vector& values, size_t year, size_t month) {
+    return values.contains(year, month);
 }
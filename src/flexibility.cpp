@@ -25,7 +25,7 @@ int swr::flexibility_graph_scenario(const std::vector<std::string>& args) {
         return 1;
     }
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years        = atoi(args[1].c_str());
     scenario.start_year   = atoi(args[2].c_str());
@@ -49,11 +49,8 @@ int swr::flexibility_graph_scenario(const std::vector<std::string>& args) {
     scenario.flexibility_threshold_2 = atof(args[10].c_str()) / 100.0f;
     scenario.flexibility_change_2    = atof(args[11].c_str()) / 100.0f;
 
-    scenario.wmethod        = swr::WithdrawalMethod::STANDARD;
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.wmethod = swr::WithdrawalMethod::STANDARD;
+    scenario.market  = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     const float portfolio_add = 20;
     const float start_wr      = 3.0f;
@@ -68,12 +65,7 @@ int swr::flexibility_graph_scenario(const std::vector<std::string>& args) {
             return 1;
         }
 
-        for (size_t i = 0; i <= 100; i += portfolio_add) {
-            scenario.portfolio[0].allocation = static_cast<float>(i);
-            scenario.portfolio[1].allocation = static_cast<float>(100 - i);
-
-            multiple_wr_success_graph(g, "", true, scenario, start_wr, end_wr, add_wr);
-        }
+        multiple_wr_success_graph(g, true, scenario, swr::allocation_grid(portfolio_add), start_wr, end_wr, add_wr);
     } else {
         swr::normalize_portfolio(scenario.portfolio);
         multiple_wr_success_graph(g, "", true, scenario, start_wr, end_wr, add_wr);
@@ -88,7 +80,7 @@ int swr::flexibility_auto_graph_scenario(const std::vector<std::string>& args) {
         return 1;
     }
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years        = atoi(args[1].c_str());
     scenario.start_year   = atoi(args[2].c_str());
@@ -107,11 +99,8 @@ int swr::flexibility_auto_graph_scenario(const std::vector<std::string>& args) {
         return 1;
     }
 
-    scenario.wmethod        = swr::WithdrawalMethod::STANDARD;
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.wmethod = swr::WithdrawalMethod::STANDARD;
+    scenario.market  = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     const float success_start_wr   = 3.5f;
     const float success_end_wr     = 5.5f;
@@ -168,7 +168,7 @@ int fixed_scenario(const std::vector<std::string>& args, swr::Simulation method)
         return 1;
     }
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
     scenario.simulation = method;
 
     scenario.wr           = atof(args[1].c_str());
@@ -188,8 +188,7 @@ int fixed_scenario(const std::vector<std::string>& args, swr::Simulation method)
 
     swr::normalize_portfolio(scenario.portfolio);
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     std::cout << "Withdrawal Rate (WR): " << scenario.wr << "%\n"
               << "     Number of years: " << scenario.years << "\n"
@@ -203,8 +202,8 @@ int fixed_scenario(const std::vector<std::string>& args, swr::Simulation method)
         std::cout << "             " << position.asset << ": " << position.allocation << "%\n";
     }
 
-    if (!swr::prepare_exchange_rates(scenario, "usd")) {
-        std::cout << "Error with exchange rates\n";
+    if (!scenario.market) {
+        std::cout << "Error with the market data\n";
         return 1;
     }
 
@@ -276,7 +275,7 @@ int single_swr_scenario(const std::vector<std::string>& args) {
         return 1;
     }
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years        = atoi(args[1].c_str());
     scenario.start_year   = atoi(args[2].c_str());
@@ -295,8 +294,7 @@ int single_swr_scenario(const std::vector<std::string>& args) {
 
     swr::normalize_portfolio(scenario.portfolio);
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     for (auto& position : scenario.portfolio) {
         std::cout << "             " << position.asset << ": " << position.allocation << "%\n";
@@ -309,10 +307,11 @@ int single_swr_scenario(const std::vector<std::string>& args) {
     float        best_wr = 0.0f;
     swr::results best_results;
 
-    for (float wr = 6.0f; wr >= 2.0f; wr -= 0.01f) {
-        scenario.wr = wr;
+    // The scenario is validated and prepared once for all the rates
+    const auto plan = swr::prepare(scenario);
 
-        auto results = swr::simulation(scenario);
+    for (float wr = 6.0f; wr >= 2.0f; wr -= 0.01f) {
+        auto results = swr::simulation(plan, wr);
 
         if (!results.message.empty()) {
             std::cout << results.message << "\n";
@@ -347,7 +346,7 @@ int multiple_swr_scenario(const std::vector<std::string>& args) {
         return 1;
     }
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years        = atoi(args[1].c_str());
     scenario.start_year   = atoi(args[2].c_str());
@@ -356,8 +355,7 @@ int multiple_swr_scenario(const std::vector<std::string>& args) {
     const auto& inflation = args[5];
     scenario.rebalance    = swr::parse_rebalance(args[6]);
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     std::cout << "     Number of years: " << scenario.years << "\n"
               << "           Rebalance: " << scenario.rebalance << "\n"
@@ -401,7 +399,7 @@ int withdraw_frequency_scenario(std::string_view command, const std::vector<std:
 
     const bool graph = command == "withdraw_frequency_graph";
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.wr           = atof(args[1].c_str());
     scenario.years        = atoi(args[2].c_str());
@@ -419,8 +417,7 @@ int withdraw_frequency_scenario(std::string_view command, const std::vector<std:
         portfolio_add = atof(args[8].c_str());
     }
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     std::cout << "Withdrawal Rate (WR): " << scenario.wr << "%\n"
               << "     Number of years: " << scenario.years << "\n"
@@ -446,8 +443,6 @@ int withdraw_frequency_scenario(std::string_view command, const std::vector<std:
         std::cout << "\n";
     }
 
-    swr::prepare_exchange_rates(scenario, "usd");
-
     if (total_allocation(scenario.portfolio) == 0.0f) {
         if (scenario.portfolio.size() != 2) {
             std::cout << "Portfolio allocation cannot be zero!\n";
@@ -594,7 +589,7 @@ int frequency_scenario(const std::vector<std::string>& args) {
 
     const auto months = years * 12;
 
-    std::vector<swr::data>::const_iterator returns;
+    swr::data_vector_iterator returns;
 
     float  total       = 0;
     float  max         = 0;
@@ -711,7 +706,7 @@ int analysis_scenario(const std::vector<std::string>& args) {
 
     auto to_returns_graph = [start_year, end_year](auto& graph, const auto& data, std::string_view title) {
         std::map<float, float> yearly_results;
-        for (auto& value : data) {
+        for (const auto& value : data) {
             if (value.year < start_year || value.year > end_year) {
                 continue;
             }
@@ -729,7 +724,7 @@ int analysis_scenario(const std::vector<std::string>& args) {
 
     auto to_price_graph = [start_year, end_year](auto& graph, const auto& data, std::string_view title) {
         std::map<float, float> yearly_results;
-        for (auto& value : data) {
+        for (const auto& value : data) {
             if (value.year < start_year || value.year > end_year) {
                 continue;
             }
@@ -1134,7 +1129,7 @@ int term_scenario(const std::vector<std::string>& args) {
 
 int glidepath_scenario(std::string_view command, const std::vector<std::string>& args) {
     std::cout << "\n";
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     const bool graph = command == "glidepath_graph" || command == "reverse_glidepath_graph";
 
@@ -1161,10 +1156,7 @@ int glidepath_scenario(std::string_view command, const std::vector<std::string>&
     }
 
     swr::normalize_portfolio(scenario.portfolio);
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     std::stringstream failsafe_ss;
 
@@ -1340,7 +1332,7 @@ int glidepath_scenario(std::string_view command, const std::vector<std::string>&
 int failsafe_scenario(std::string_view command, const std::vector<std::string>& args) {
     const bool graph = command == "failsafe_graph";
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years        = atoi(args[1].c_str());
     scenario.start_year   = atoi(args[2].c_str());
@@ -1354,10 +1346,7 @@ int failsafe_scenario(std::string_view command, const std::vector<std::string>&
         portfolio_add = atof(args[7].c_str());
     }
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     swr::Graph g(graph, "Failsafe SWR (%)");
     g.title_  = std::format("Failsafe Withdrawal Rates - {} Years - {}-{}", scenario.years, scenario.start_year, scenario.end_year);
@@ -1420,7 +1409,7 @@ int data_graph_scenario(const std::vector<std::string>& args) {
         std::map<float, float> results;
         float                  acc_value = 1;
 
-        for (auto& value : values[i]) {
+        for (const auto& value : values[i]) {
             if (value.year >= start_year) {
                 if (value.month == 12) {
                     results[value.year] = acc_value;
@@ -1438,6 +1427,19 @@ int data_graph_scenario(const std::vector<std::string>& args) {
     return 0;
 }
 
+int data_snapshot_scenario() {
+    const auto version = swr::write_snapshot();
+
+    if (!version) {
+        std::cout << "Error with the snapshot of the data\n";
+        return 1;
+    }
+
+    std::cout << std::format("Wrote the snapshot of the data (version {:016x})\n", version);
+
+    return 0;
+}
+
 int data_time_graph_scenario(const std::vector<std::string>& args) {
     if (args.size() < 5) {
         std::cout << "Not enough arguments for data_time_graph\n";
@@ -1459,7 +1461,7 @@ int data_time_graph_scenario(const std::vector<std::string>& args) {
 
         float acc_value = 1000.0f;
 
-        for (auto& value : values[i]) {
+        for (const auto& value : values[i]) {
             if (value.year >= start_year) {
                 const int64_t timestamp = (value.year - 1970) * 365 * 24 * 3600 + (value.month - 1) * 31 * 24 * 3600;
                 results[timestamp]      = log ? logf(acc_value) : acc_value;
@@ -1484,7 +1486,7 @@ int trinity_success_scenario(std::string_view command, const std::vector<std::st
 
     const bool graph = command == "trinity_success_graph";
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years        = atoi(args[1].c_str());
     scenario.start_year   = atoi(args[2].c_str());
@@ -1527,35 +1529,36 @@ int trinity_success_scenario(std::string_view command, const std::vector<std::st
 
     swr::configure_withdrawal_method(scenario, args, 14);
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
+
+    if (!scenario.market) {
+        std::cout << "Error with the market data\n";
+        return 1;
+    }
 
     if (args.size() > 15) {
         const std::string& country = args[15];
 
         if (country == "switzerland") {
-            auto exchange_data = swr::load_exchange("usd_chf");
-
-            scenario.exchange_rates.resize(scenario.values.size());
+            auto market        = *scenario.market;
+            auto exchange_data = swr::shared_exchange("usd_chf");
 
+            // Only the US stocks are converted
             for (size_t i = 0; i < scenario.portfolio.size(); ++i) {
-                scenario.exchange_rates[i] = exchange_data;
                 if (scenario.portfolio[i].asset == "us_stocks") {
-                    scenario.exchange_rates[i] = exchange_data;
+                    market.exchange_set[i]   = true;
+                    market.exchange_rates[i] = exchange_data;
                 } else {
-                    scenario.exchange_rates[i] = exchange_data;
-
-                    for (auto& v : scenario.exchange_rates[i]) {
-                        v.value = 1;
-                    }
+                    market.exchange_set[i]   = false;
+                    market.exchange_rates[i] = nullptr; // Not used by the simulation
                 }
             }
+
+            scenario.market = std::make_shared<const swr::market_data>(std::move(market));
         } else {
             std::cout << "No support for country: " << country << "\n";
             return 1;
         }
-    } else {
-        swr::prepare_exchange_rates(scenario, "usd");
     }
 
     swr::Graph g(graph);
@@ -1576,15 +1579,10 @@ int trinity_success_scenario(std::string_view command, const std::vector<std::st
             return 1;
         }
 
-        for (size_t i = 0; i <= 100; i += portfolio_add) {
-            scenario.portfolio[0].allocation = static_cast<float>(i);
-            scenario.portfolio[1].allocation = static_cast<float>(100 - i);
-
-            if (graph) {
-                swr::multiple_wr_success_graph(g, "", true, scenario, start_wr, end_wr, add_wr);
-            } else {
-                swr::multiple_wr_success_sheets("", scenario, start_wr, end_wr, add_wr);
-            }
+        if (graph) {
+            swr::multiple_wr_success_graph(g, true, scenario, swr::allocation_grid(portfolio_add), start_wr, end_wr, add_wr);
+        } else {
+            swr::multiple_wr_success_sheets(scenario, swr::allocation_grid(portfolio_add), start_wr, end_wr, add_wr);
         }
     } else {
         swr::normalize_portfolio(scenario.portfolio);
@@ -1604,7 +1602,10 @@ int die_with_zero_scenario(const std::vector<std::string>& args) {
         return 1;
     }
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
+
+    // The simulations already run on the thread pool of the command
+    scenario.threads = 1;
 
     scenario.years      = atoi(args[1].c_str());
     scenario.start_year = atoi(args[2].c_str());
@@ -1627,10 +1628,7 @@ int die_with_zero_scenario(const std::vector<std::string>& args) {
         scenario.wmethod = swr::WithdrawalMethod::DIE_WITH_ZERO;
     }
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     swr::Graph g4(true, "Terminal Value (USD)", "bar-graph");
     g4.title_ = std::format("Terminal values - {} Years - {}-{}", scenario.years, scenario.start_year, scenario.end_year);
@@ -1773,7 +1771,7 @@ int trinity_cash_graphs_scenario(const std::vector<std::string>& args) {
         return 1;
     }
 
-    swr::scenario base_scenario;
+    swr::scenario base_scenario = swr::command_scenario();
 
     base_scenario.years      = atoi(args[1].c_str());
     base_scenario.start_year = atoi(args[2].c_str());
@@ -1820,11 +1818,9 @@ int trinity_cash_graphs_scenario(const std::vector<std::string>& args) {
     quality_graph.set_extra(R"("legend_position": "right",)");
 
     {
-        auto scenario_bonds           = base_scenario;
-        scenario_bonds.portfolio      = swr::parse_portfolio("us_bonds:0;us_stocks:0;", true);
-        scenario_bonds.values         = swr::load_values(scenario_bonds.portfolio);
-        scenario_bonds.inflation_data = swr::load_inflation(scenario_bonds.values, "us_inflation");
-        swr::prepare_exchange_rates(scenario_bonds, "usd");
+        auto scenario_bonds      = base_scenario;
+        scenario_bonds.portfolio = swr::parse_portfolio("us_bonds:0;us_stocks:0;", true);
+        scenario_bonds.market    = swr::load_market_data(scenario_bonds.portfolio, "us_inflation", "usd");
 
         for (size_t i = 0; i <= 100; i += portfolio_add) {
             scenario_bonds.portfolio[1].allocation = static_cast<float>(i);
@@ -1838,11 +1834,9 @@ int trinity_cash_graphs_scenario(const std::vector<std::string>& args) {
     }
 
     {
-        auto scenario_cash           = base_scenario;
-        scenario_cash.portfolio      = swr::parse_portfolio("cash:0;us_stocks:0;", true);
-        scenario_cash.values         = swr::load_values(scenario_cash.portfolio);
-        scenario_cash.inflation_data = swr::load_inflation(scenario_cash.values, "us_inflation");
-        swr::prepare_exchange_rates(scenario_cash, "usd");
+        auto scenario_cash      = base_scenario;
+        scenario_cash.portfolio = swr::parse_portfolio("cash:0;us_stocks:0;", true);
+        scenario_cash.market    = swr::load_market_data(scenario_cash.portfolio, "us_inflation", "usd");
 
         for (size_t i = 0; i <= 100 - portfolio_add; i += portfolio_add) {
             scenario_cash.portfolio[1].allocation = static_cast<float>(i);
@@ -1861,7 +1855,7 @@ int trinity_cash_graphs_scenario(const std::vector<std::string>& args) {
 int trinity_duration_scenario(std::string_view command, const std::vector<std::string>& args) {
     const bool graph = command == "trinity_duration_graph";
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years        = atoi(args[1].c_str());
     scenario.start_year   = atoi(args[2].c_str());
@@ -1882,10 +1876,7 @@ int trinity_duration_scenario(std::string_view command, const std::vector<std::s
 
     const float portfolio_add = 25;
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     if (!graph) {
         std::cout << "Portfolio";
@@ -1902,15 +1893,10 @@ int trinity_duration_scenario(std::string_view command, const std::vector<std::s
 
     {
         swr::Graph g(graph, "Worst Duration (months)");
-        for (size_t i = 0; i <= 100; i += portfolio_add) {
-            scenario.portfolio[0].allocation = static_cast<float>(i);
-            scenario.portfolio[1].allocation = static_cast<float>(100 - i);
-
-            if (graph) {
-                swr::multiple_wr_duration_graph(g, "", true, scenario, start_wr, end_wr, add_wr);
-            } else {
-                swr::multiple_wr_duration_sheets("", scenario, start_wr, end_wr, add_wr);
-            }
+        if (graph) {
+            swr::multiple_wr_duration_graph(g, true, scenario, swr::allocation_grid(portfolio_add), start_wr, end_wr, add_wr);
+        } else {
+            swr::multiple_wr_duration_sheets(scenario, swr::allocation_grid(portfolio_add), start_wr, end_wr, add_wr);
         }
     }
 
@@ -1918,15 +1904,10 @@ int trinity_duration_scenario(std::string_view command, const std::vector<std::s
 
     {
         swr::Graph g(graph);
-        for (size_t i = 0; i <= 100; i += portfolio_add) {
-            scenario.portfolio[0].allocation = static_cast<float>(i);
-            scenario.portfolio[1].allocation = static_cast<float>(100 - i);
-
-            if (graph) {
-                swr::multiple_wr_success_graph(g, "", true, scenario, start_wr, end_wr, add_wr);
-            } else {
-                swr::multiple_wr_success_sheets("", scenario, start_wr, end_wr, add_wr);
-            }
+        if (graph) {
+            swr::multiple_wr_success_graph(g, true, scenario, swr::allocation_grid(portfolio_add), start_wr, end_wr, add_wr);
+        } else {
+            swr::multiple_wr_success_sheets(scenario, swr::allocation_grid(portfolio_add), start_wr, end_wr, add_wr);
         }
     }
 
@@ -1943,7 +1924,7 @@ int trinity_tv_scenario(std::string_view command, const std::vector<std::string>
 
     swr::Graph g(graph, "Value (USD)", "bar-graph");
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years        = atoi(args[1].c_str());
     scenario.start_year   = atoi(args[2].c_str());
@@ -1962,10 +1943,7 @@ int trinity_tv_scenario(std::string_view command, const std::vector<std::string>
     const float end_wr   = 5.0f;
     const float add_wr   = 0.25f;
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     if (!graph) {
         std::cout << "Withdrawal Rate";
@@ -1997,7 +1975,7 @@ int trinity_spending_scenario(std::string_view command, const std::vector<std::s
     swr::Graph g1(graph, "Average Spending (USD)", "bar-graph");
     swr::Graph g2(graph, "Spending Trends Years", "bar-graph");
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years        = atoi(args[1].c_str());
     scenario.start_year   = atoi(args[2].c_str());
@@ -2016,10 +1994,7 @@ int trinity_spending_scenario(std::string_view command, const std::vector<std::s
     const float end_wr   = 5.0f;
     const float add_wr   = 0.1f;
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     if (!graph) {
         std::cout << "Withdrawal Rate";
@@ -2052,7 +2027,7 @@ int income_scenario(const std::vector<std::string>& args) {
         return 1;
     }
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.fees         = 0.001;
     scenario.years        = atoi(args[1].c_str());
@@ -2071,13 +2046,10 @@ int income_scenario(const std::vector<std::string>& args) {
     float end_wr   = atof(args[8].c_str());
     float add_wr   = atof(args[9].c_str());
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     scenario.extra_income = true;
 
-    swr::prepare_exchange_rates(scenario, "usd");
-
     swr::Graph g(true);
 
     swr::normalize_portfolio(scenario.portfolio);
@@ -2107,7 +2079,7 @@ int social_scenario(std::string_view command, const std::vector<std::string>& ar
 
     const bool graph = command == "social_graph";
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.fees         = 0.001;
     scenario.years        = atoi(args[1].c_str());
@@ -2135,10 +2107,7 @@ int social_scenario(std::string_view command, const std::vector<std::string>& ar
         scenario.initial_cash = atof(args[12].c_str());
     }
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     swr::Graph g(graph);
 
@@ -2180,7 +2149,7 @@ int social_pf_scenario(std::string_view command, const std::vector<std::string>&
 
     const bool graph = command == "social_pf_graph";
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.fees         = 0.001;
     scenario.years        = atoi(args[1].c_str());
@@ -2203,10 +2172,7 @@ int social_pf_scenario(std::string_view command, const std::vector<std::string>&
     scenario.social_delay    = atoi(args[10].c_str());
     auto base_coverage       = atof(args[11].c_str()) / 100.0f;
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     swr::Graph g(graph);
 
@@ -2247,7 +2213,7 @@ int current_wr_scenario(std::string_view command, const std::vector<std::string>
 
     const bool graph = command == "current_wr_graph";
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.wmethod      = swr::WithdrawalMethod::CURRENT;
     scenario.years        = atoi(args[1].c_str());
@@ -2288,10 +2254,7 @@ int current_wr_scenario(std::string_view command, const std::vector<std::string>
         scenario.wmethod = swr::WithdrawalMethod::STANDARD;
     }
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     if (!graph) {
         std::cout << "Portfolio";
@@ -2322,41 +2285,28 @@ int current_wr_scenario(std::string_view command, const std::vector<std::string>
             return 1;
         }
 
-        for (size_t i = 0; i <= 100; i += portfolio_add) {
-            scenario.portfolio[0].allocation = static_cast<float>(i);
-            scenario.portfolio[1].allocation = static_cast<float>(100 - i);
+        const auto allocations = swr::allocation_grid(portfolio_add);
 
-            if (graph) {
-                swr::multiple_wr_success_graph(success_graph, "", true, scenario, start_wr, end_wr, add_wr);
-            } else {
-                swr::multiple_wr_success_sheets("", scenario, start_wr, end_wr, add_wr);
-            }
+        if (graph) {
+            swr::multiple_wr_success_graph(success_graph, true, scenario, allocations, start_wr, end_wr, add_wr);
+        } else {
+            swr::multiple_wr_success_sheets(scenario, allocations, start_wr, end_wr, add_wr);
         }
 
         std::cout << '\n';
 
-        for (size_t i = 0; i <= 100; i += portfolio_add) {
-            scenario.portfolio[0].allocation = static_cast<float>(i);
-            scenario.portfolio[1].allocation = static_cast<float>(100 - i);
-
-            if (graph) {
-                swr::multiple_wr_withdrawn_graph(withdrawn_graph, "", true, scenario, start_wr, end_wr, add_wr);
-            } else {
-                swr::multiple_wr_withdrawn_sheets("", scenario, start_wr, end_wr, add_wr);
-            }
+        if (graph) {
+            swr::multiple_wr_withdrawn_graph(withdrawn_graph, true, scenario, allocations, start_wr, end_wr, add_wr);
+        } else {
+            swr::multiple_wr_withdrawn_sheets(scenario, allocations, start_wr, end_wr, add_wr);
         }
 
         std::cout << '\n';
 
-        for (size_t i = 0; i <= 100; i += portfolio_add) {
-            scenario.portfolio[0].allocation = static_cast<float>(i);
-            scenario.portfolio[1].allocation = static_cast<float>(100 - i);
-
-            if (graph) {
-                swr::multiple_wr_duration_graph(duration_graph, "", true, scenario, start_wr, end_wr, add_wr);
-            } else {
-                swr::multiple_wr_duration_sheets("", scenario, start_wr, end_wr, add_wr);
-            }
+        if (graph) {
+            swr::multiple_wr_duration_graph(duration_graph, true, scenario, allocations, start_wr, end_wr, add_wr);
+        } else {
+            swr::multiple_wr_duration_sheets(scenario, allocations, start_wr, end_wr, add_wr);
         }
     } else {
         swr::Graph g(graph);
@@ -2381,7 +2331,7 @@ int rebalance_scenario(std::string_view command, const std::vector<std::string>&
 
     const bool graph = command == "rebalance_graph";
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years        = atoi(args[1].c_str());
     scenario.start_year   = atoi(args[2].c_str());
@@ -2393,10 +2343,7 @@ int rebalance_scenario(std::string_view command, const std::vector<std::string>&
     const float end_wr   = 6.0f;
     const float add_wr   = 0.1f;
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     swr::Graph g(graph);
     g.title_ = swr::portfolio_to_blog_string(scenario, false) + " - " + std::to_string(scenario.years) + " Years - Rebalance method";
@@ -2451,7 +2398,7 @@ int threshold_rebalance_scenario(std::string_view command, const std::vector<std
 
     const bool graph = command == "threshold_rebalance_graph";
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years        = atoi(args[1].c_str());
     scenario.start_year   = atoi(args[2].c_str());
@@ -2463,10 +2410,7 @@ int threshold_rebalance_scenario(std::string_view command, const std::vector<std
     const float end_wr   = 6.0f;
     const float add_wr   = 0.1f;
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     swr::Graph g(graph);
     g.title_ = swr::portfolio_to_blog_string(scenario, false) + " - " + std::to_string(scenario.years) + " Years - Rebalance threshold";
@@ -2541,7 +2485,7 @@ int trinity_low_yield_scenario(std::string_view command, const std::vector<std::
 
     const bool graph = command == "trinity_low_yield_graph";
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years           = atoi(args[1].c_str());
     scenario.start_year      = atoi(args[2].c_str());
@@ -2557,8 +2501,12 @@ int trinity_low_yield_scenario(std::string_view command, const std::vector<std::
 
     const float portfolio_add = 10;
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
+
+    if (!scenario.market) {
+        std::cout << "Error with the market data\n";
+        return 1;
+    }
 
     auto real_scenario = scenario;
 
@@ -2583,21 +2531,28 @@ int trinity_low_yield_scenario(std::string_view command, const std::vector<std::
         std::cout << "\n";
     }
 
+    // The real scenario keeps the historical data, the adjusted yields are in a copy
     if (yield_adjust < 1.0f) {
+        auto market = *scenario.market;
+
         for (size_t i = 0; i < scenario.portfolio.size(); ++i) {
             if (scenario.portfolio[i].asset == "us_bonds") {
-                for (auto& value : scenario.values[i]) {
+                // The shared series is not modified, the adjusted one replaces it
+                auto bonds = *market.values[i];
+
+                for (auto& value : bonds.data) {
                     // We must adjust only the part above 1.0f
-                    value.value = 1.0f + (value.value - 1.0f) * yield_adjust;
+                    value = 1.0f + (value - 1.0f) * yield_adjust;
                 }
 
+                market.values[i] = std::make_shared<const swr::data_vector>(std::move(bonds));
+
                 break;
             }
         }
-    }
 
-    swr::prepare_exchange_rates(scenario, "usd");
-    swr::prepare_exchange_rates(real_scenario, "usd");
+        scenario.market = std::make_shared<const swr::market_data>(std::move(market));
+    }
 
     auto start = std::chrono::high_resolution_clock::now();
 
@@ -2607,21 +2562,21 @@ int trinity_low_yield_scenario(std::string_view command, const std::vector<std::
             return 1;
         }
 
-        for (size_t i = 0; i <= 100; i += portfolio_add) {
-            scenario.portfolio[0].allocation = static_cast<float>(i);
-            scenario.portfolio[1].allocation = static_cast<float>(100 - i);
+        if (g.enabled_) {
+            swr::multiple_wr_success_graph(g, true, scenario, swr::allocation_grid(portfolio_add), start_wr, end_wr, add_wr);
+        } else {
+            swr::multiple_wr_success_sheets(scenario, swr::allocation_grid(portfolio_add), start_wr, end_wr, add_wr);
+        }
 
-            real_scenario.portfolio[0].allocation = static_cast<float>(i);
-            real_scenario.portfolio[1].allocation = static_cast<float>(100 - i);
+        if (gp.enabled_) {
+            for (size_t i = 0; i <= 100; i += portfolio_add) {
+                if (i == 60 || i == 40) {
+                    scenario.portfolio[0].allocation = static_cast<float>(i);
+                    scenario.portfolio[1].allocation = static_cast<float>(100 - i);
 
-            if (g.enabled_) {
-                swr::multiple_wr_success_graph(g, "", true, scenario, start_wr, end_wr, add_wr);
-            } else {
-                swr::multiple_wr_success_sheets("", scenario, start_wr, end_wr, add_wr);
-            }
+                    real_scenario.portfolio[0].allocation = static_cast<float>(i);
+                    real_scenario.portfolio[1].allocation = static_cast<float>(100 - i);
 
-            if (gp.enabled_) {
-                if (i == 60 || i == 40) {
                     swr::multiple_wr_success_graph(gp,
                                                    std::format("{} ({}%)", swr::portfolio_to_string(scenario, true), static_cast<uint32_t>(yield_adjust * 100)),
                                                    true,
@@ -2665,7 +2620,7 @@ int times_graph_scenario(const std::vector<std::string>& args) {
         return 1;
     }
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years          = atoi(args[1].c_str());
     scenario.start_year     = atoi(args[2].c_str());
@@ -2673,8 +2628,7 @@ int times_graph_scenario(const std::vector<std::string>& args) {
     scenario.portfolio      = swr::parse_portfolio(args[4], true);
     const auto& inflation   = args[5];
     scenario.wmethod        = swr::WithdrawalMethod::STANDARD;
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
+    scenario.market         = swr::load_market_data(scenario.portfolio, inflation, "usd");
     scenario.rebalance      = swr::parse_rebalance(args[6]);
     scenario.wr             = 4.0f;
     const bool normalize    = args[7] == "true";
@@ -2692,8 +2646,8 @@ int times_graph_scenario(const std::vector<std::string>& args) {
 
     std::cout << scenario << "\n";
 
-    if (!swr::prepare_exchange_rates(scenario, "usd")) {
-        std::cout << "Error with exchange rates\n";
+    if (!scenario.market) {
+        std::cout << "Error with the market data\n";
         return 1;
     }
 
@@ -2769,7 +2723,7 @@ int selection_graph_scenario(const std::vector<std::string>& args) {
         return 1;
     }
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years          = atoi(args[1].c_str());
     scenario.start_year     = atoi(args[2].c_str());
@@ -2777,8 +2731,7 @@ int selection_graph_scenario(const std::vector<std::string>& args) {
     scenario.portfolio      = swr::parse_portfolio(args[4], true);
     const auto& inflation   = args[5];
     scenario.wmethod        = swr::WithdrawalMethod::STANDARD;
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
+    scenario.market         = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     const std::string& test = args[6];
     if (args[6] == "none") {
@@ -2794,8 +2747,8 @@ int selection_graph_scenario(const std::vector<std::string>& args) {
         std::cout << " " << position.asset << ": " << position.allocation << "%\n";
     }
 
-    if (!swr::prepare_exchange_rates(scenario, "usd")) {
-        std::cout << "Error with exchange rates\n";
+    if (!scenario.market) {
+        std::cout << "Error with the market data\n";
         return 1;
     }
 
@@ -2892,7 +2845,10 @@ int trinity_cash_graph_scenario(std::string_view command, const std::vector<std:
 
     const bool graph = command == "trinity_cash_graph";
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
+
+    // The simulations already run on the thread pool of the command
+    scenario.threads = 1;
 
     scenario.years        = atoi(args[1].c_str());
     scenario.start_year   = atoi(args[2].c_str());
@@ -2921,10 +2877,7 @@ int trinity_cash_graph_scenario(std::string_view command, const std::vector<std:
         compare = args[10] == "true";
     }
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     swr::Graph success_graph(graph);
     success_graph.xtitle_ = "Months of cash";
@@ -3114,7 +3067,7 @@ int method_success_scenario(const std::vector<std::string>& args, bool mc) {
 
     const bool graph = true;
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years        = atoi(args[1].c_str());
     scenario.start_year   = atoi(args[2].c_str());
@@ -3127,10 +3080,7 @@ int method_success_scenario(const std::vector<std::string>& args, bool mc) {
     const float end_wr   = 5.0f;
     const float add_wr   = 0.1f;
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     swr::Graph g(graph);
     if (mc) {
@@ -3187,7 +3137,7 @@ int method_duration_scenario(const std::vector<std::string>& args, bool mc) {
 
     const bool graph = true;
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years        = atoi(args[1].c_str());
     scenario.start_year   = atoi(args[2].c_str());
@@ -3200,10 +3150,7 @@ int method_duration_scenario(const std::vector<std::string>& args, bool mc) {
     const float end_wr   = 5.0f;
     const float add_wr   = 0.1f;
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     swr::Graph g(graph, "Worst duration (months)");
     if (mc) {
@@ -3260,7 +3207,7 @@ int method_tv_scenario(const std::vector<std::string>& args, bool mc) {
 
     const bool graph = true;
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.years        = atoi(args[1].c_str());
     scenario.start_year   = atoi(args[2].c_str());
@@ -3273,10 +3220,7 @@ int method_tv_scenario(const std::vector<std::string>& args, bool mc) {
     const float end_wr   = 5.0f;
     const float add_wr   = 0.1f;
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     swr::Graph g(graph, "Value (USD)", "bar-graph");
     if (mc) {
@@ -3305,7 +3249,7 @@ int method_tv_scenario(const std::vector<std::string>& args, bool mc) {
 int periods_success_scenario(bool mc) {
     const bool graph = true;
 
-    swr::scenario scenario;
+    swr::scenario scenario = swr::command_scenario();
 
     scenario.simulation   = mc ? swr::Simulation::MONTE_CARLO : swr::Simulation::BOOTSTRAPPING;
     scenario.years        = 50;
@@ -3319,10 +3263,7 @@ int periods_success_scenario(bool mc) {
     const float end_wr   = 5.0f;
     const float add_wr   = 0.1f;
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
-
-    swr::prepare_exchange_rates(scenario, "usd");
+    scenario.market = swr::load_market_data(scenario.portfolio, inflation, "usd");
 
     swr::Graph g(graph);
     if (mc) {
@@ -3413,6 +3354,8 @@ int main(int argc, const char* argv[]) {
             return failsafe_scenario(command, args);
         } else if (command == "data_graph") {
             return data_graph_scenario(args);
+        } else if (command == "data_snapshot") {
+            return data_snapshot_scenario();
         } else if (command == "data_time_graph") {
             return data_time_graph_scenario(args);
         } else if (command == "trinity_success_sheets" || command == "trinity_success_graph") {
@@ -60,3 +60,13 @@ float swr::total_allocation(std::vector<allocation>& portfolio) {
 
     return total;
 }
+
+std::vector<std::vector<float>> swr::allocation_grid(float step) {
+    std::vector<std::vector<float>> allocations;
+
+    for (size_t i = 0; i <= 100; i += step) {
+        allocations.push_back({static_cast<float>(i), static_cast<float>(100 - i)});
+    }
+
+    return allocations;
+}
@@ -0,0 +1,210 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2019-2024.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <array>
+#include <bit>
+
+#include "random.hpp"
+
+// The loops below are written without branches, float comparisons or calls
+// to the standard library so that the compiler can vectorize them without
+// relaxing the floating point model. The polynomial approximations are the
+// ones of Cephes and are accurate to a few ulps.
+
+namespace {
+
+using philox_block = std::array<uint32_t, 4>;
+
+constexpr uint32_t philox_m0 = 0xD2511F53;
+constexpr uint32_t philox_m1 = 0xCD9E8D57;
+constexpr uint32_t philox_w0 = 0x9E3779B9;
+constexpr uint32_t philox_w1 = 0xBB67AE85;
+
+philox_block philox(philox_block c, uint32_t k0, uint32_t k1) {
+    for (size_t round = 0; round < 10; ++round) {
+        const uint64_t p0 = static_cast<uint64_t>(philox_m0) * c[0];
+        const uint64_t p1 = static_cast<uint64_t>(philox_m1) * c[2];
+
+        c = {static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k0,
+             static_cast<uint32_t>(p1),
+             static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k1,
+             static_cast<uint32_t>(p0)};
+
+        k0 += philox_w0;
+        k1 += philox_w1;
+    }
+
+    return c;
+}
+
+// Natural logarithm of x in (0, 1]
+float log_unit(float x) {
+    const uint32_t bits = std::bit_cast<uint32_t>(x);
+
+    // x = m * 2^e with m in [0.5, 1)
+    float e = static_cast<float>(static_cast<int32_t>(bits >> 23) - 126);
+    float m = std::bit_cast<float>((bits & 0x007FFFFF) | 0x3F000000);
+
+    // Center m around 1 (the mantissa of sqrt(0.5) is 0x3504F3)
+    const bool small = (bits & 0x007FFFFF) < 0x003504F3;
+    e                = small ? e - 1.0f : e;
+    m                = small ? m + m - 1.0f : m - 1.0f;
+
+    const float z = m * m;
+
+    float y = 7.0376836292E-2f;
+    y       = y * m - 1.1514610310E-1f;
+    y       = y * m + 1.1676998740E-1f;
+    y       = y * m - 1.2420140846E-1f;
+    y       = y * m + 1.4249322787E-1f;
+    y       = y * m - 1.6668057665E-1f;
+    y       = y * m + 2.0000714765E-1f;
+    y       = y * m - 2.4999993993E-1f;
+    y       = y * m + 3.3333331174E-1f;
+    y       = y * m * z;
+
+    y += -2.12194440E-4f * e;
+    y += -0.5f * z;
+
+    return m + y + 0.693359375f * e;
+}
+
+// Square root of x > 0, from the inverse square root refined by Newton steps
+float sqrt_positive(float x) {
+    float y = std::bit_cast<float>(0x5F375A86 - (std::bit_cast<uint32_t>(x) >> 1));
+
+    for (size_t step = 0; step < 3; ++step) {
+        y = y * (1.5f - 0.5f * x * y * y);
+    }
+
+    return x * y;
+}
+
+// Round to the nearest integer, for |x| < 2^22
+float round_nearest(float x) {
+    constexpr float magic = 12582912.0f; // 1.5 * 2^23
+
+    return (x + magic) - magic;
+}
+
+} // namespace
+
+void swr::random_paths::uniforms(uint32_t* values, size_t n, uint64_t path) {
+    const auto k0 = static_cast<uint32_t>(seed);
+    const auto k1 = static_cast<uint32_t>(seed >> 32);
+
+    // The counter of a block is its index in the path, the path and the stream
+    auto block = [&](size_t b) {
+        return philox({static_cast<uint32_t>(b), static_cast<uint32_t>(path), static_cast<uint32_t>(stream), static_cast<uint32_t>(stream >> 32)}, k0, k1);
+    };
+
+    const size_t blocks = n / 4;
+
+    for (size_t b = 0; b < blocks; ++b) {
+        const auto numbers = block(b);
+
+        for (size_t j = 0; j < 4; ++j) {
+            values[4 * b + j] = numbers[j];
+        }
+    }
+
+    if (n % 4) {
+        const auto numbers = block(blocks);
+
+        for (size_t j = 0; j < n % 4; ++j) {
+            values[4 * blocks + j] = numbers[j];
+        }
+    }
+}
+
+void swr::random_paths::normals(float* values, size_t n, uint64_t path) {
+    // Box-Muller: each pair of uniform numbers gives a cosine and a sine normal
+    const size_t pairs = (n + 1) / 2;
+
+    bits.resize(2 * pairs);
+    uniforms(bits.data(), 2 * pairs, path);
+
+    const uint32_t* first  = bits.data();
+    const uint32_t* second = bits.data() + pairs;
+
+    auto radius = [](uint32_t bits) {
+        // Uniform in (0, 1), the logarithm is never zero
+        const float u = (static_cast<float>(bits >> 8) + 0.5f) * 0x1.0p-24f;
+        return sqrt_positive(-2.0f * log_unit(u));
+    };
+
+    auto angle = [](uint32_t bits, float& s, float& c) {
+        // 2 * pi * u = q * pi / 2 + r with r in [-pi / 4, pi / 4]
+        const float   t = static_cast<float>(bits >> 8) * 0x1.0p-22f;
+        const int32_t q = static_cast<int32_t>(t + 0.5f);
+        const float   r = (t - static_cast<float>(q)) * 1.57079632679489661923f;
+        const float   z = r * r;
+
+        float rs = -1.9515295891E-4f;
+        rs       = rs * z + 8.3321608736E-3f;
+        rs       = rs * z - 1.6666654611E-1f;
+        rs       = rs * z * r + r;
+
+        float rc = 2.443315711809948E-5f;
+        rc       = rc * z - 1.388731625493765E-3f;
+        rc       = rc * z + 4.166664568298827E-2f;
+        rc       = rc * z * z - 0.5f * z + 1.0f;
+
+        // Move back to the quadrant of the angle
+        const bool swap = q & 1;
+        s               = swap ? rc : rs;
+        c               = swap ? rs : rc;
+        s               = (q & 2) ? -s : s;
+        c               = ((q + 1) & 2) ? -c : c;
+    };
+
+    const size_t full = n / 2;
+
+    for (size_t i = 0; i < full; ++i) {
+        const float r = radius(first[i]);
+
+        float s;
+        float c;
+        angle(second[i], s, c);
+
+        values[i]        = r * c;
+        values[full + i] = r * s;
+    }
+
+    // An odd count only uses the cosine of the last pair
+    if (n % 2) {
+        float s;
+        float c;
+        angle(second[full], s, c);
+
+        values[n - 1] = radius(first[full]) * c;
+    }
+}
+
+void swr::exp_inplace(float* values, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        float x = values[i];
+
+        // exp(x) = 2^k * exp(r) with r in [-ln(2) / 2, ln(2) / 2]
+        const float   kf = round_nearest(x * 1.44269504088896341f);
+        const int32_t k  = static_cast<int32_t>(kf);
+        x -= kf * 0.693359375f;
+        x -= kf * -2.12194440E-4f;
+
+        const float z = x * x;
+
+        float y = 1.9875691500E-4f;
+        y       = y * x + 1.3981999507E-3f;
+        y       = y * x + 8.3334519073E-3f;
+        y       = y * x + 4.1665795894E-2f;
+        y       = y * x + 1.6666665459E-1f;
+        y       = y * x + 5.0000001201E-1f;
+        y       = y * z + x + 1.0f;
+
+        values[i] = y * std::bit_cast<float>(static_cast<uint32_t>(k + 127) << 23);
+    }
+}
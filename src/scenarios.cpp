@@ -12,6 +12,7 @@
 #include <chrono>
 #include <sstream>
 #include <iomanip>
+#include <thread>
 
 #include "data.hpp"
 #include "portfolio.hpp"
@@ -35,97 +36,180 @@ void csv_print(const std::string& header, const std::vector<T>& values) {
     std::cout << "\n";
 }
 
+// The withdrawal rates from start_wr to end_wr (included) by add_wr
+std::vector<float> wr_range(float start_wr, float end_wr, float add_wr) {
+    std::vector<float> rates;
+
+    for (float wr = start_wr; wr < end_wr + add_wr / 2.0f; wr += add_wr) {
+        rates.push_back(wr);
+    }
+
+    return rates;
+}
+
+// Simulate all the rates in one batch, the threads of the scenario split the periods of the batch
+std::vector<swr::results> multiple_wr_simulation(const swr::scenario& scenario, const std::vector<float>& rates, swr::Statistics statistics) {
+    auto my_scenario       = scenario;
+    my_scenario.statistics = statistics;
+
+    return swr::simulation(my_scenario, rates);
+}
+
+// Simulate all the allocations and all the rates in one batch
+std::vector<swr::results> multiple_wr_simulation(const swr::scenario&                   scenario,
+                                                 const std::vector<std::vector<float>>& allocations,
+                                                 const std::vector<float>&              rates,
+                                                 swr::Statistics                        statistics) {
+    auto my_scenario       = scenario;
+    my_scenario.statistics = statistics;
+
+    return swr::simulation(my_scenario, allocations, rates);
+}
+
+// Set the allocation of each asset of the portfolio
+void set_allocation(swr::scenario& scenario, const std::vector<float>& allocation) {
+    for (size_t i = 0; i < allocation.size(); ++i) {
+        scenario.portfolio[i].allocation = allocation[i];
+    }
+}
+
+// Add the results of a portfolio for each rate to the graph
+template <typename F>
+void add_wr_data(swr::Graph& graph, const std::vector<float>& rates, const swr::results* all_results, F& functor) {
+    std::map<float, float> results;
+
+    for (size_t i = 0; i < rates.size(); ++i) {
+        if (all_results[i].error) {
+            results[rates[i]] = 0.0f;
+            std::cout << "\nERROR: " << all_results[i].message << "\n";
+        } else {
+            results[rates[i]] = functor(all_results[i], rates[i]);
+        }
+    }
+
+    graph.add_data(results);
+}
+
 template <typename F>
-void multiple_wr_graph(
-        swr::Graph& graph, std::string_view title, bool shortForm, const swr::scenario& scenario, float start_wr, float end_wr, float add_wr, F functor) {
+void multiple_wr_graph(swr::Graph&          graph,
+                       std::string_view     title,
+                       bool                 shortForm,
+                       const swr::scenario& scenario,
+                       float                start_wr,
+                       float                end_wr,
+                       float                add_wr,
+                       swr::Statistics      statistics,
+                       F                    functor) {
     if (title.empty()) {
         graph.add_legend(portfolio_to_string(scenario, shortForm));
     } else {
         graph.add_legend(title);
     }
 
-    cpp::default_thread_pool pool(2 * std::thread::hardware_concurrency());
-    std::map<float, float>   results;
+    const auto rates       = wr_range(start_wr, end_wr, add_wr);
+    const auto all_results = multiple_wr_simulation(scenario, rates, statistics);
 
-    for (float wr = start_wr; wr < end_wr + add_wr / 2.0f; wr += add_wr) {
-        results[wr] = 0.0f;
+    add_wr_data(graph, rates, all_results.data(), functor);
+}
+
+// One line for each of the allocations, all the allocations are simulated in one batch
+template <typename F>
+void multiple_wr_graph(swr::Graph&                            graph,
+                       bool                                   shortForm,
+                       const swr::scenario&                   scenario,
+                       const std::vector<std::vector<float>>& allocations,
+                       float                                  start_wr,
+                       float                                  end_wr,
+                       float                                  add_wr,
+                       swr::Statistics                        statistics,
+                       F                                      functor) {
+    const auto rates       = wr_range(start_wr, end_wr, add_wr);
+    const auto all_results = multiple_wr_simulation(scenario, allocations, rates, statistics);
+
+    auto my_scenario = scenario;
+
+    for (size_t a = 0; a < allocations.size(); ++a) {
+        set_allocation(my_scenario, allocations[a]);
+
+        graph.add_legend(portfolio_to_string(my_scenario, shortForm));
+        add_wr_data(graph, rates, all_results.data() + a * rates.size(), functor);
     }
+}
 
-    std::atomic<bool> error = false;
+// Print the allocation of a portfolio, as the title of its line
+void print_portfolio(const swr::scenario& scenario) {
+    for (const auto& position : scenario.portfolio) {
+        if (position.allocation > 0) {
+            std::cout << position.allocation << "% " << position.asset << " ";
+        }
+    }
+}
 
-    for (float wr = start_wr; wr < end_wr + add_wr / 2.0f; wr += add_wr) {
-        pool.do_task(
-                [&results, &scenario, &error, &functor](float wr) {
-                    auto my_scenario = scenario;
-                    my_scenario.wr   = wr;
-                    auto res         = swr::simulation(my_scenario);
+// Print the results of a portfolio for each rate
+template <typename F>
+void print_wr_data(const std::vector<float>& rates, const swr::results* all_results, F& functor) {
+    std::vector<float> results(rates.size(), 0.0f);
 
-                    if (res.error) {
-                        error = false;
-                        std::cout << "\nERROR: " << res.message << "\n";
-                    } else {
-                        results[wr] = functor(res, wr);
-                    }
-                },
-                wr);
+    for (size_t i = 0; i < rates.size(); ++i) {
+        if (all_results[i].error) {
+            std::cout << "\nERROR: " << all_results[i].message << "\n";
+        } else {
+            results[i] = functor(all_results[i]);
+        }
     }
 
-    pool.wait();
-
-    if (!error) {
-        graph.add_data(results);
+    for (auto& res : results) {
+        std::cout << ';' << res;
     }
+
+    std::cout << "\n";
 }
 
 template <typename F>
-void multiple_wr_sheets(std::string_view title, const swr::scenario& scenario, float start_wr, float end_wr, float add_wr, F functor) {
+void multiple_wr_sheets(
+        std::string_view title, const swr::scenario& scenario, float start_wr, float end_wr, float add_wr, swr::Statistics statistics, F functor) {
     if (title.empty()) {
-        for (const auto& position : scenario.portfolio) {
-            if (position.allocation > 0) {
-                std::cout << position.allocation << "% " << position.asset << " ";
-            }
-        }
+        print_portfolio(scenario);
     } else {
         std::cout << title << " ";
     }
 
-    cpp::default_thread_pool pool(2 * std::thread::hardware_concurrency());
-    std::vector<float>       results;
+    const auto rates       = wr_range(start_wr, end_wr, add_wr);
+    const auto all_results = multiple_wr_simulation(scenario, rates, statistics);
 
-    for (float wr = start_wr; wr < end_wr + add_wr / 2.0f; wr += add_wr) {
-        results.push_back(0.0f);
-    }
+    print_wr_data(rates, all_results.data(), functor);
+}
 
-    std::size_t       i     = 0;
-    std::atomic<bool> error = false;
+// One line for each of the allocations, all the allocations are simulated in one batch
+template <typename F>
+void multiple_wr_sheets(const swr::scenario&                   scenario,
+                        const std::vector<std::vector<float>>& allocations,
+                        float                                  start_wr,
+                        float                                  end_wr,
+                        float                                  add_wr,
+                        swr::Statistics                        statistics,
+                        F                                      functor) {
+    const auto rates       = wr_range(start_wr, end_wr, add_wr);
+    const auto all_results = multiple_wr_simulation(scenario, allocations, rates, statistics);
 
-    for (float wr = start_wr; wr < end_wr + add_wr / 2.0f; wr += add_wr) {
-        pool.do_task(
-                [&results, &scenario, &error, &functor](float wr, size_t i) {
-                    auto my_scenario = scenario;
-                    my_scenario.wr   = wr;
-                    auto res         = swr::simulation(my_scenario);
-
-                    if (res.error) {
-                        error = false;
-                        std::cout << "\nERROR: " << res.message << "\n";
-                    } else {
-                        results[i] = functor(res);
-                    }
-                },
-                wr,
-                i++);
-    }
-
-    pool.wait();
-
-    if (!error) {
-        for (auto& res : results) {
-            std::cout << ';' << res;
-        }
+    auto my_scenario = scenario;
+
+    for (size_t a = 0; a < allocations.size(); ++a) {
+        set_allocation(my_scenario, allocations[a]);
+
+        print_portfolio(my_scenario);
+        print_wr_data(rates, all_results.data() + a * rates.size(), functor);
     }
+}
 
-    std::cout << "\n";
+void print_failsafe(const swr::critical_rates& rates, float goal, std::ostream& out) {
+    const auto index = rates.failsafe(goal);
+
+    if (index < rates.grid.size()) {
+        out << std::format(";{:.2f}", rates.grid[index]);
+    } else {
+        out << ";0";
+    }
 }
 
 } // namespace
@@ -138,38 +222,21 @@ void swr::multiple_wr(const swr::scenario& scenario) {
 
     std::cout << "\n";
 
-    cpp::default_thread_pool pool(std::thread::hardware_concurrency());
-
-    std::vector<swr::results> all_yearly_results;
-    std::vector<swr::results> all_monthly_results;
+    std::vector<float> rates;
 
     for (float wr = 3.0; wr < 5.1f; wr += 0.25f) {
-        all_yearly_results.emplace_back();
-        all_monthly_results.emplace_back();
+        rates.push_back(wr);
     }
 
-    size_t i = 0;
-
-    for (float wr = 3.0; wr < 5.1f; wr += 0.25f) {
-        pool.do_task(
-                [&scenario, &all_yearly_results, &all_monthly_results](float wr, size_t i) {
-                    auto my_scenario = scenario;
+    auto my_scenario = scenario;
 
-                    my_scenario.wr                 = wr;
-                    my_scenario.withdraw_frequency = 12;
-
-                    all_yearly_results[i] = swr::simulation(my_scenario);
-
-                    my_scenario.withdraw_frequency = 1;
-                    all_monthly_results[i]         = swr::simulation(my_scenario);
-                },
-                wr,
-                i++);
-    }
+    my_scenario.withdraw_frequency = 12;
+    auto all_yearly_results        = multiple_wr_simulation(my_scenario, rates, scenario.statistics);
 
-    pool.wait();
+    my_scenario.withdraw_frequency = 1;
+    auto all_monthly_results       = multiple_wr_simulation(my_scenario, rates, scenario.statistics);
 
-    i = 0;
+    size_t i = 0;
 
     for (float wr = 3.0; wr < 5.1f; wr += 0.25f) {
         auto& yearly_results  = all_yearly_results[i];
@@ -302,7 +369,7 @@ std::string swr::portfolio_to_string(const swr::scenario& scenario, bool shortFo
 std::map<float, swr::results> swr::multiple_wr_success_graph_save(
         swr::Graph& graph, std::string_view title, bool shortForm, const swr::scenario& scenario, float start_wr, float end_wr, float add_wr) {
     std::map<float, swr::results> all_results;
-    multiple_wr_graph(graph, title, shortForm, scenario, start_wr, end_wr, add_wr, [&all_results](const auto& results, float wr) {
+    multiple_wr_graph(graph, title, shortForm, scenario, start_wr, end_wr, add_wr, swr::Statistics::FULL, [&all_results](const auto& results, float wr) {
         all_results[wr] = results;
         return results.success_rate;
     });
@@ -311,12 +378,16 @@ std::map<float, swr::results> swr::multiple_wr_success_graph_save(
 
 void swr::multiple_wr_success_graph(
         swr::Graph& graph, std::string_view title, bool shortForm, const swr::scenario& scenario, float start_wr, float end_wr, float add_wr) {
-    multiple_wr_graph(graph, title, shortForm, scenario, start_wr, end_wr, add_wr, [](const auto& results, float) { return results.success_rate; });
+    multiple_wr_graph(graph, title, shortForm, scenario, start_wr, end_wr, add_wr, swr::Statistics::SUCCESS, [](const auto& results, float) {
+        return results.success_rate;
+    });
 }
 
 void swr::multiple_wr_withdrawn_graph(
         swr::Graph& graph, std::string_view title, bool shortForm, const swr::scenario& scenario, float start_wr, float end_wr, float add_wr) {
-    multiple_wr_graph(graph, title, shortForm, scenario, start_wr, end_wr, add_wr, [](const auto& results, float) { return results.withdrawn_per_year; });
+    multiple_wr_graph(graph, title, shortForm, scenario, start_wr, end_wr, add_wr, swr::Statistics::SUCCESS, [](const auto& results, float) {
+        return results.withdrawn_per_year;
+    });
 }
 
 void swr::multiple_wr_errors_graph(swr::Graph&                          graph,
@@ -327,7 +398,7 @@ void swr::multiple_wr_errors_graph(swr::Graph&                          graph,
                                    float                                end_wr,
                                    float                                add_wr,
                                    const std::map<float, swr::results>& base_results) {
-    multiple_wr_graph(graph, title, shortForm, scenario, start_wr, end_wr, add_wr, [&base_results](const auto& results, float wr) {
+    multiple_wr_graph(graph, title, shortForm, scenario, start_wr, end_wr, add_wr, swr::Statistics::FULL, [&base_results](const auto& results, float wr) {
         const auto& base_result = base_results.at(wr);
 
         size_t errors = 0;
@@ -344,7 +415,7 @@ void swr::multiple_wr_errors_graph(swr::Graph&                          graph,
 
 void swr::multiple_wr_duration_graph(
         swr::Graph& graph, std::string_view title, bool shortForm, const swr::scenario& scenario, float start_wr, float end_wr, float add_wr) {
-    multiple_wr_graph(graph, title, shortForm, scenario, start_wr, end_wr, add_wr, [&scenario](const auto& results, float) {
+    multiple_wr_graph(graph, title, shortForm, scenario, start_wr, end_wr, add_wr, swr::Statistics::SUCCESS, [&scenario](const auto& results, float) {
         if (results.failures) {
             return results.worst_duration;
         }
@@ -354,7 +425,7 @@ void swr::multiple_wr_duration_graph(
 
 void swr::multiple_wr_quality_graph(
         swr::Graph& graph, std::string_view title, bool shortForm, const swr::scenario& scenario, float start_wr, float end_wr, float add_wr) {
-    multiple_wr_graph(graph, title, shortForm, scenario, start_wr, end_wr, add_wr, [&scenario](const auto& results, float) {
+    multiple_wr_graph(graph, title, shortForm, scenario, start_wr, end_wr, add_wr, swr::Statistics::SUCCESS, [&scenario](const auto& results, float) {
         if (results.failures) {
             return results.success_rate * (results.worst_duration / (scenario.years * 12.0f));
         }
@@ -363,15 +434,76 @@ void swr::multiple_wr_quality_graph(
 }
 
 void swr::multiple_wr_success_sheets(std::string_view title, const swr::scenario& scenario, float start_wr, float end_wr, float add_wr) {
-    multiple_wr_sheets(title, scenario, start_wr, end_wr, add_wr, [](const auto& results) { return results.success_rate; });
+    multiple_wr_sheets(title, scenario, start_wr, end_wr, add_wr, swr::Statistics::SUCCESS, [](const auto& results) { return results.success_rate; });
 }
 
 void swr::multiple_wr_withdrawn_sheets(std::string_view title, const swr::scenario& scenario, float start_wr, float end_wr, float add_wr) {
-    multiple_wr_sheets(title, scenario, start_wr, end_wr, add_wr, [](const auto& results) { return results.withdrawn_per_year; });
+    multiple_wr_sheets(title, scenario, start_wr, end_wr, add_wr, swr::Statistics::SUCCESS, [](const auto& results) { return results.withdrawn_per_year; });
 }
 
 void swr::multiple_wr_duration_sheets(std::string_view title, const swr::scenario& scenario, float start_wr, float end_wr, float add_wr) {
-    multiple_wr_sheets(title, scenario, start_wr, end_wr, add_wr, [&scenario](const auto& results) {
+    multiple_wr_sheets(title, scenario, start_wr, end_wr, add_wr, swr::Statistics::SUCCESS, [&scenario](const auto& results) {
+        if (results.failures) {
+            return results.worst_duration;
+        }
+        return scenario.years * 12;
+    });
+}
+
+void swr::multiple_wr_success_graph(swr::Graph&                            graph,
+                                    bool                                   shortForm,
+                                    const swr::scenario&                   scenario,
+                                    const std::vector<std::vector<float>>& allocations,
+                                    float                                  start_wr,
+                                    float                                  end_wr,
+                                    float                                  add_wr) {
+    multiple_wr_graph(graph, shortForm, scenario, allocations, start_wr, end_wr, add_wr, swr::Statistics::SUCCESS, [](const auto& results, float) {
+        return results.success_rate;
+    });
+}
+
+void swr::multiple_wr_withdrawn_graph(swr::Graph&                            graph,
+                                      bool                                   shortForm,
+                                      const swr::scenario&                   scenario,
+                                      const std::vector<std::vector<float>>& allocations,
+                                      float                                  start_wr,
+                                      float                                  end_wr,
+                                      float                                  add_wr) {
+    multiple_wr_graph(graph, shortForm, scenario, allocations, start_wr, end_wr, add_wr, swr::Statistics::SUCCESS, [](const auto& results, float) {
+        return results.withdrawn_per_year;
+    });
+}
+
+void swr::multiple_wr_duration_graph(swr::Graph&                            graph,
+                                     bool                                   shortForm,
+                                     const swr::scenario&                   scenario,
+                                     const std::vector<std::vector<float>>& allocations,
+                                     float                                  start_wr,
+                                     float                                  end_wr,
+                                     float                                  add_wr) {
+    multiple_wr_graph(graph, shortForm, scenario, allocations, start_wr, end_wr, add_wr, swr::Statistics::SUCCESS, [&scenario](const auto& results, float) {
+        if (results.failures) {
+            return results.worst_duration;
+        }
+        return scenario.years * 12;
+    });
+}
+
+void swr::multiple_wr_success_sheets(
+        const swr::scenario& scenario, const std::vector<std::vector<float>>& allocations, float start_wr, float end_wr, float add_wr) {
+    multiple_wr_sheets(scenario, allocations, start_wr, end_wr, add_wr, swr::Statistics::SUCCESS, [](const auto& results) { return results.success_rate; });
+}
+
+void swr::multiple_wr_withdrawn_sheets(
+        const swr::scenario& scenario, const std::vector<std::vector<float>>& allocations, float start_wr, float end_wr, float add_wr) {
+    multiple_wr_sheets(scenario, allocations, start_wr, end_wr, add_wr, swr::Statistics::SUCCESS, [](const auto& results) {
+        return results.withdrawn_per_year;
+    });
+}
+
+void swr::multiple_wr_duration_sheets(
+        const swr::scenario& scenario, const std::vector<std::vector<float>>& allocations, float start_wr, float end_wr, float add_wr) {
+    multiple_wr_sheets(scenario, allocations, start_wr, end_wr, add_wr, swr::Statistics::SUCCESS, [&scenario](const auto& results) {
         if (results.failures) {
             return results.worst_duration;
         }
@@ -384,10 +516,12 @@ void swr::multiple_wr_tv_graph(swr::Graph& graph, swr::scenario scenario, float
     std::map<float, float> avg_tv;
     std::map<float, float> med_tv;
 
-    for (float wr = start_wr; wr < end_wr + add_wr / 2.0f; wr += add_wr) {
-        scenario.wr = wr;
+    const auto rates       = wr_range(start_wr, end_wr, add_wr);
+    const auto all_results = swr::simulation(scenario, rates);
 
-        auto results = swr::simulation(scenario);
+    for (size_t i = 0; i < rates.size(); ++i) {
+        const float wr      = rates[i];
+        const auto& results = all_results[i];
 
         max_tv[wr] = results.tv_maximum;
         avg_tv[wr] = results.tv_average;
@@ -406,7 +540,7 @@ void swr::multiple_wr_tv_graph(swr::Graph& graph, swr::scenario scenario, float
 
 void swr::multiple_wr_avg_tv_graph(swr::Graph& graph, std::string_view title, const swr::scenario& scenario, float start_wr, float end_wr, float add_wr) {
     std::map<float, swr::results> all_results;
-    multiple_wr_graph(graph, title, true, scenario, start_wr, end_wr, add_wr, [&all_results](const auto& results, float wr) {
+    multiple_wr_graph(graph, title, true, scenario, start_wr, end_wr, add_wr, swr::Statistics::SUMMARY, [&all_results](const auto& results, float wr) {
         all_results[wr] = results;
         return results.tv_average;
     });
@@ -418,9 +552,7 @@ void swr::multiple_wr_tv_sheets(swr::scenario scenario, float start_wr, float en
     std::vector<float> avg_tv;
     std::vector<float> med_tv;
 
-    for (float wr = start_wr; wr < end_wr + add_wr / 2.0f; wr += add_wr) {
-        scenario.wr          = wr;
-        auto monthly_results = swr::simulation(scenario);
+    for (const auto& monthly_results : swr::simulation(scenario, wr_range(start_wr, end_wr, add_wr))) {
         min_tv.push_back(monthly_results.tv_minimum);
         max_tv.push_back(monthly_results.tv_maximum);
         avg_tv.push_back(monthly_results.tv_average);
@@ -439,10 +571,12 @@ void swr::multiple_wr_spending_graph(swr::Graph& graph, swr::scenario scenario,
     std::map<float, float> avg_spending;
     std::map<float, float> med_spending;
 
-    for (float wr = start_wr; wr < end_wr + add_wr / 2.0f; wr += add_wr) {
-        scenario.wr = wr;
+    const auto rates       = wr_range(start_wr, end_wr, add_wr);
+    const auto all_results = swr::simulation(scenario, rates);
 
-        auto results = swr::simulation(scenario);
+    for (size_t i = 0; i < rates.size(); ++i) {
+        const float wr      = rates[i];
+        const auto& results = all_results[i];
 
         max_spending[wr] = results.spending_maximum;
         min_spending[wr] = results.spending_minimum;
@@ -469,10 +603,12 @@ void swr::multiple_wr_spending_trend_graph(swr::Graph& graph, swr::scenario scen
     std::map<float, float> volatile_up_spending;
     std::map<float, float> volatile_down_spending;
 
-    for (float wr = start_wr; wr < end_wr + add_wr / 2.0f; wr += add_wr) {
-        scenario.wr = wr;
+    const auto rates       = wr_range(start_wr, end_wr, add_wr);
+    const auto all_results = swr::simulation(scenario, rates);
 
-        auto results = swr::simulation(scenario);
+    for (size_t i = 0; i < rates.size(); ++i) {
+        const float wr      = rates[i];
+        const auto& results = all_results[i];
 
         small_spending[wr]         = 100.0f * (results.years_small_spending / static_cast<float>(results.successes * scenario.years));
         large_spending[wr]         = 100.0f * (results.years_large_spending / static_cast<float>(results.successes * scenario.years));
@@ -499,9 +635,7 @@ void swr::multiple_wr_spending_sheets(swr::scenario scenario, float start_wr, fl
     std::vector<float> avg_spending;
     std::vector<float> med_spending;
 
-    for (float wr = start_wr; wr < end_wr + add_wr / 2.0f; wr += add_wr) {
-        scenario.wr          = wr;
-        auto monthly_results = swr::simulation(scenario);
+    for (const auto& monthly_results : swr::simulation(scenario, wr_range(start_wr, end_wr, add_wr))) {
         min_spending.push_back(monthly_results.spending_minimum);
         max_spending.push_back(monthly_results.spending_maximum);
         avg_spending.push_back(monthly_results.spending_average);
@@ -514,10 +648,26 @@ void swr::multiple_wr_spending_sheets(swr::scenario scenario, float start_wr, fl
     csv_print("MAX", max_spending);
 }
 
-float swr::failsafe_swr_one(swr::scenario& scenario, float start_wr, float end_wr, float step, float goal) {
+float swr::failsafe_swr_one(const swr::scenario& scenario, float start_wr, float end_wr, float step, float goal) {
+    // Solve the critical rate of each period instead of scanning the rates
+    if (swr::critical_rates_supported(scenario)) {
+        auto rates = swr::critical_withdrawal_rates(scenario, start_wr, end_wr, step);
+
+        if (!rates.error) {
+            const auto index = rates.failsafe(goal);
+            return index < rates.grid.size() ? rates.grid[index] : 0.0f;
+        }
+    }
+
+    // Only the success rate is needed
+    auto my_scenario       = scenario;
+    my_scenario.statistics = swr::Statistics::SUCCESS;
+
+    // The scenario is validated and prepared once for all the rates
+    const auto plan = swr::prepare(my_scenario);
+
     for (float wr = start_wr; wr >= end_wr; wr -= step) {
-        scenario.wr          = wr;
-        auto monthly_results = swr::simulation(scenario);
+        auto monthly_results = swr::simulation(plan, wr);
 
         if (monthly_results.success_rate >= 100.0f - goal) {
             return wr;
@@ -527,10 +677,26 @@ float swr::failsafe_swr_one(swr::scenario& scenario, float start_wr, float end_w
     return 0.0f;
 }
 
-void swr::failsafe_swr(swr::scenario& scenario, float start_wr, float end_wr, float step, float goal, std::ostream& out) {
+void swr::failsafe_swr(const swr::scenario& scenario, float start_wr, float end_wr, float step, float goal, std::ostream& out) {
+    // Solve the critical rate of each period instead of scanning the rates
+    if (swr::critical_rates_supported(scenario)) {
+        auto rates = swr::critical_withdrawal_rates(scenario, start_wr, end_wr, step);
+
+        if (!rates.error) {
+            print_failsafe(rates, goal, out);
+            return;
+        }
+    }
+
+    // Only the success rate is needed
+    auto my_scenario       = scenario;
+    my_scenario.statistics = swr::Statistics::SUCCESS;
+
+    // The scenario is validated and prepared once for all the rates
+    const auto plan = swr::prepare(my_scenario);
+
     for (float wr = start_wr; wr >= end_wr; wr -= step) {
-        scenario.wr          = wr;
-        auto monthly_results = swr::simulation(scenario);
+        auto monthly_results = swr::simulation(plan, wr);
 
         if (monthly_results.success_rate >= 100.0f - goal) {
             out << std::format(";{:.2f}", wr);
@@ -541,13 +707,27 @@ void swr::failsafe_swr(swr::scenario& scenario, float start_wr, float end_wr, fl
     out << ";0";
 }
 
-void swr::failsafe_swr(std::string_view title, swr::scenario& scenario, float start_wr, float end_wr, float step, std::ostream& out) {
+void swr::failsafe_swr(std::string_view title, const swr::scenario& scenario, float start_wr, float end_wr, float step, std::ostream& out) {
     if (title.empty()) {
         out << portfolio_to_string(scenario, true);
     } else {
         out << title << " ";
     }
 
+    // The critical rates are solved once for all the goals
+    if (swr::critical_rates_supported(scenario)) {
+        auto rates = swr::critical_withdrawal_rates(scenario, start_wr, end_wr, step);
+
+        if (!rates.error) {
+            for (float goal : {0.0f, 1.0f, 5.0f, 10.0f, 25.0f}) {
+                print_failsafe(rates, goal, out);
+            }
+
+            out << '\n';
+            return;
+        }
+    }
+
     failsafe_swr(scenario, start_wr, end_wr, step, 0.0f, out);
     failsafe_swr(scenario, start_wr, end_wr, step, 1.0f, out);
     failsafe_swr(scenario, start_wr, end_wr, step, 5.0f, out);
@@ -563,9 +743,10 @@ void swr::multiple_rebalance_sheets(swr::scenario scenario, float start_wr, floa
         std::cout << scenario.rebalance << " ";
     }
 
-    for (float wr = start_wr; wr < end_wr + add_wr / 2.0f; wr += add_wr) {
-        scenario.wr          = wr;
-        auto monthly_results = swr::simulation(scenario);
+    // Only the success rate is needed
+    scenario.statistics = swr::Statistics::SUCCESS;
+
+    for (const auto& monthly_results : swr::simulation(scenario, wr_range(start_wr, end_wr, add_wr))) {
         std::cout << ';' << monthly_results.success_rate;
     }
 
@@ -575,10 +756,14 @@ void swr::multiple_rebalance_sheets(swr::scenario scenario, float start_wr, floa
 void swr::multiple_rebalance_graph(swr::Graph& graph, swr::scenario scenario, float start_wr, float end_wr, float add_wr) {
     std::map<float, float> data;
 
-    for (float wr = start_wr; wr < end_wr + add_wr / 2.0f; wr += add_wr) {
-        scenario.wr  = wr;
-        auto results = swr::simulation(scenario);
-        data[wr]     = results.success_rate;
+    // Only the success rate is needed
+    scenario.statistics = swr::Statistics::SUCCESS;
+
+    const auto rates       = wr_range(start_wr, end_wr, add_wr);
+    const auto all_results = swr::simulation(scenario, rates);
+
+    for (size_t i = 0; i < rates.size(); ++i) {
+        data[rates[i]] = all_results[i].success_rate;
     }
 
     if (scenario.rebalance == swr::Rebalancing::THRESHOLD) {
@@ -619,3 +804,9 @@ void swr::configure_withdrawal_method(swr::scenario& scenario, std::vector<std::
         scenario.wmethod = swr::WithdrawalMethod::STANDARD;
     }
 }
+
+swr::scenario swr::command_scenario() {
+    swr::scenario scenario;
+    scenario.threads = std::thread::hardware_concurrency();
+    return scenario;
+}
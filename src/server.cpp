@@ -12,6 +12,13 @@
 #include <chrono>
 #include <sstream>
 #include <iomanip>
+#include <thread>
+#include <memory>
+#include <stop_token>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "data.hpp"
 #include "portfolio.hpp"
@@ -28,9 +35,24 @@ namespace {
 
 httplib::Server* server_ptr = nullptr;
 
+// Written by SIGHUP (a write is safe in a signal handler), the data is reloaded
+// by the reload thread waiting on the other end (not in the signal handler)
+int reload_pipe[2] = {-1, -1};
+
+void wake_reload_thread(char request) {
+    if (reload_pipe[1] >= 0) {
+        [[maybe_unused]] auto written = write(reload_pipe[1], &request, 1);
+    }
+}
+
 void server_signal_handler(int signum) {
     std::cout << "Received signal (" << signum << ")\n";
 
+    if (signum == SIGHUP) {
+        wake_reload_thread('r');
+        return;
+    }
+
     if (server_ptr) {
         server_ptr->stop();
     }
@@ -43,10 +65,58 @@ void install_signal_handler() {
     action.sa_handler = server_signal_handler;
     sigaction(SIGTERM, &action, nullptr);
     sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGHUP, &action, nullptr);
+
+    if (pipe(reload_pipe) == 0) {
+        // With a full pipe, a reload is already pending and the handler must not block
+        fcntl(reload_pipe[1], F_SETFL, O_NONBLOCK);
+    } else {
+        std::cout << "ERROR: Cannot create the reload pipe, SIGHUP will not reload the data\n";
+    }
 
     std::cout << "Installed the signal handler\n";
 }
 
+// Reload the data in the background when requested, the requests in flight finish with
+// the previous data and the next ones use the new data
+void reload_loop(std::stop_token stop) {
+    if (reload_pipe[0] < 0) {
+        return;
+    }
+
+    // The thread is woken up to stop as well
+    std::stop_callback wake(stop, [] { wake_reload_thread('s'); });
+
+    char requests[64];
+
+    while (!stop.stop_requested()) {
+        // The signals received since the last reload only give one more reload
+        const auto read_bytes = read(reload_pipe[0], requests, sizeof(requests));
+
+        if (read_bytes < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (read_bytes <= 0) {
+            std::cout << "ERROR: Cannot read the reload pipe, SIGHUP will not reload the data\n";
+            return;
+        }
+
+        if (stop.stop_requested()) {
+            return;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        const bool complete = swr::reload_data();
+
+        auto stop_tp  = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop_tp - start).count();
+        std::cout << "Reloaded the data in " << duration << "ms" << (complete ? "" : " (some series kept their previous data)") << "\n";
+        std::cout << std::format("Data version {:016x}\n", swr::data_version());
+    }
+}
+
 bool check_parameters(const httplib::Request& req, httplib::Response& res, const std::vector<const char*>& parameters) {
     using namespace std::string_literals;
     for (const auto& param : parameters) {
@@ -59,6 +129,13 @@ bool check_parameters(const httplib::Request& req, httplib::Response& res, const
     return true;
 }
 
+// Cancel the simulations of a request once its client has disconnected
+std::shared_ptr<swr::cancellation_token> client_cancellation(const httplib::Request& req) {
+    auto token       = std::make_shared<swr::cancellation_token>();
+    token->condition = [&req]() { return req.is_connection_closed(); };
+    return token;
+}
+
 void server_simple_api(const httplib::Request& req, httplib::Response& res) {
     if (!check_parameters(req, res, {"inflation", "years", "wr", "start", "end"})) {
         return;
@@ -79,6 +156,16 @@ void server_simple_api(const httplib::Request& req, httplib::Response& res) {
 
     // Don't run for too long
     scenario.timeout_msecs = 200;
+    scenario.cancellation  = client_cancellation(req);
+
+    // Under load, rather answer with the simulations done in time than fail
+    scenario.anytime = true;
+
+    // The requests are already served concurrently, each simulation keeps its thread
+    // (the default) for the server not to start threads for each request
+
+    // Only the distributions are reported, not the values of each period
+    scenario.statistics = swr::Statistics::SUMMARY;
 
     auto inflation = req.get_param_value("inflation");
     if (req.has_param("inflation2")) {
@@ -267,28 +354,38 @@ void server_simple_api(const httplib::Request& req, httplib::Response& res) {
         scenario.simulation = swr::Simulation::BACKTESTING;
     }
 
+    // The same seed always gives the same random simulations
+    if (req.has_param("seed")) {
+        scenario.seed = strtoull(req.get_param_value("seed").c_str(), nullptr, 10);
+    }
+
     std::cout << "DEBUG: Request " << scenario << "\n";
 
     swr::normalize_portfolio(scenario.portfolio);
 
-    scenario.values         = swr::load_values(scenario.portfolio);
-    scenario.inflation_data = swr::load_inflation(scenario.values, inflation);
+    swr::market_data market;
 
-    if (scenario.values.empty()) {
+    market.values = swr::shared_values(scenario.portfolio);
+
+    if (market.values.empty()) {
         res.set_content(R"({"results": {"message":"Error: Invalid portfolio", "error": true}})", "text/json");
         return;
     }
 
-    if (scenario.inflation_data.empty()) {
+    market.inflation_data = swr::shared_inflation(market.values, inflation);
+
+    if (!market.inflation_data) {
         res.set_content(R"({"results": {"message":"Error: Invalid inflation", "error": true}})", "text/json");
         return;
     }
 
-    if (!prepare_exchange_rates(scenario, currency)) {
+    if (!prepare_exchange_rates(market, scenario.portfolio, currency)) {
         res.set_content(R"({"results": {"message":"Error: Invalid exchange data", "error": true}})", "text/json");
         return;
     }
 
+    scenario.market = std::make_shared<const swr::market_data>(std::move(market));
+
     auto results = simulation(scenario);
 
     std::cout << "DEBUG: Response"
@@ -300,6 +397,10 @@ void server_simple_api(const httplib::Request& req, httplib::Response& res) {
     ss << "  \"successes\": " << results.successes << ",\n";
     ss << "  \"failures\": " << results.failures << ",\n";
     ss << "  \"success_rate\": " << results.success_rate << ",\n";
+    ss << "  \"success_lower\": " << results.success_lower << ",\n";
+    ss << "  \"success_upper\": " << results.success_upper << ",\n";
+    ss << "  \"partial\": " << (results.partial ? "true" : "false") << ",\n";
+    ss << "  \"completed\": " << results.completed << ",\n";
     ss << "  \"tv_average\": " << results.tv_average << ",\n";
     ss << "  \"tv_minimum\": " << results.tv_minimum << ",\n";
     ss << "  \"tv_maximum\": " << results.tv_maximum << ",\n";
@@ -344,6 +445,10 @@ void server_retirement_api(const httplib::Request& req, httplib::Response& res)
 
     // Don't run for too long
     scenario.timeout_msecs = 200;
+    scenario.cancellation  = client_cancellation(req);
+
+    // Only the success rate is reported
+    scenario.statistics = swr::Statistics::SUCCESS;
 
     // Parse the parameters
     scenario.wr          = atof(req.get_param_value("wr").c_str());
@@ -392,19 +497,16 @@ void server_retirement_api(const httplib::Request& req, httplib::Response& res)
     scenario.end_year           = 2022;
 
     auto portfolio_100 = swr::parse_portfolio("us_stocks:100;", false);
-    auto values_100    = swr::load_values(portfolio_100);
+    auto market_100    = swr::load_market_data(portfolio_100, "us_inflation", "usd");
 
     auto portfolio_60 = swr::parse_portfolio("us_stocks:60;us_bonds:40;", false);
-    auto values_60    = swr::load_values(portfolio_60);
+    auto market_60    = swr::load_market_data(portfolio_60, "us_inflation", "usd");
 
     auto portfolio_40 = swr::parse_portfolio("us_stocks:40;us_bonds:60;", false);
-    auto values40     = swr::load_values(portfolio_40);
-
-    scenario.inflation_data = swr::load_inflation(values_100, "us_inflation");
+    auto market_40    = swr::load_market_data(portfolio_40, "us_inflation", "usd");
 
     scenario.portfolio = portfolio_100;
-    scenario.values    = values_100;
-    prepare_exchange_rates(scenario, "usd");
+    scenario.market    = market_100;
 
     scenario.years      = 30;
     auto results_30_100 = simulation(scenario);
@@ -414,8 +516,7 @@ void server_retirement_api(const httplib::Request& req, httplib::Response& res)
     auto results_50_100 = simulation(scenario);
 
     scenario.portfolio = portfolio_60;
-    scenario.values    = values_60;
-    prepare_exchange_rates(scenario, "usd");
+    scenario.market    = market_60;
 
     scenario.years     = 30;
     auto results_30_60 = simulation(scenario);
@@ -425,8 +526,7 @@ void server_retirement_api(const httplib::Request& req, httplib::Response& res)
     auto results_50_60 = simulation(scenario);
 
     scenario.portfolio = portfolio_40;
-    scenario.values    = values40;
-    prepare_exchange_rates(scenario, "usd");
+    scenario.market    = market_40;
 
     scenario.years     = 30;
     auto results_30_40 = simulation(scenario);
@@ -832,6 +932,7 @@ void server_fi_planner_api(const httplib::Request& req, httplib::Response& res)
 
         // Don't run for too long
         scenario.timeout_msecs = 200;
+        scenario.cancellation  = client_cancellation(req);
 
         scenario.wr = wr;
 
@@ -858,12 +959,8 @@ void server_fi_planner_api(const httplib::Request& req, httplib::Response& res)
         scenario.start_year         = 1871;
         scenario.end_year           = 2025;
 
-        auto values             = swr::load_values(portfolio);
-        scenario.inflation_data = swr::load_inflation(values, "us_inflation");
-
         scenario.portfolio = portfolio;
-        scenario.values    = values;
-        prepare_exchange_rates(scenario, "usd");
+        scenario.market    = swr::load_market_data(portfolio, "us_inflation", "usd");
 
         scenario.years = retirement_years;
         auto results   = simulation(scenario);
@@ -927,6 +1024,10 @@ int swr::server(const std::vector<std::string>& args) {
 
     install_signal_handler();
 
+    std::jthread reloader(reload_loop);
+
+    std::cout << std::format("Data version {:016x}\n", swr::data_version());
+
     server_ptr = &server;
     std::cout << "Server is starting to listen on " << listen << ":" << port << "\n";
     server.listen(listen, port);
@@ -6,7 +6,6 @@
 //=======================================================================
 
 #include <algorithm>
-#include <random>
 #include <iostream>
 #include <numeric>
 #include <sstream>
@@ -15,15 +14,21 @@
 #include <array>
 #include <chrono>
 #include <utility>
+#include <atomic>
+#include <span>
 
 #include "simulation.hpp"
 #include "data.hpp"
+#include "random.hpp"
+
+#include "cpp_utils/thread_pool.hpp"
 
 namespace chr = std::chrono;
 
 namespace {
 
-size_t simulations = 0;
+// Shared by all the simulations, which can run concurrently
+std::atomic<size_t> simulations = 0;
 
 // In percent
 constexpr const float monthly_rebalancing_cost   = 0.005;
@@ -34,52 +39,121 @@ bool valid_year(const swr::data_vector& data, size_t year) {
     return year >= data.front().year && year <= data.back().year;
 }
 
-template <size_t N>
-auto current_value(const std::array<float, N>& current_values) {
+// Per-asset values of the kernels, contiguous and aligned for the vectorized loops
+// The usual portfolios are stored inline, only the larger ones need an allocation
+template <typename T>
+class asset_array {
+public:
+    static constexpr size_t inline_capacity = 8;
+
+    explicit asset_array(size_t n) : n_(n) {
+        if (n > inline_capacity) {
+            heap_.resize(n);
+            data_ = heap_.data();
+        }
+    }
+
+    // The data may point to the inline storage
+    asset_array(const asset_array& rhs) = delete;
+    asset_array& operator=(const asset_array& rhs) = delete;
+
+    size_t size() const {
+        return n_;
+    }
+
+    T& operator[](size_t i) {
+        return data_[i];
+    }
+
+    const T& operator[](size_t i) const {
+        return data_[i];
+    }
+
+    T* begin() {
+        return data_;
+    }
+
+    T* end() {
+        return data_ + n_;
+    }
+
+private:
+    size_t n_;
+
+    alignas(32) std::array<T, inline_capacity> inline_{};
+    std::vector<T> heap_;
+    T*             data_ = inline_.data();
+};
+
+float current_value(const asset_array<float>& current_values) {
     float value = 0.0f;
-    for (size_t i = 0; i < N; ++i) {
+    for (size_t i = 0; i < current_values.size(); ++i) {
         value += current_values[i];
     }
     return value;
 }
 
-template <size_t N>
-bool glidepath(swr::scenario& scenario, swr::context& context, std::array<float, N>& current_values) {
-    if (scenario.glidepath) {
-        // Check if we have already reached the target
-        if (scenario.portfolio[0].allocation_ == scenario.gp_goal) {
-            return true;
-        }
+// The configuration of the scenario that is fixed at compile time in the scalar kernel
+// The kernel is instantiated for each policy and selected once per simulation, so that
+// the monthly steps do not branch on the configuration of the scenario
+template <swr::WithdrawalMethod W, swr::Flexibility F, swr::Rebalancing R, bool Extras>
+struct kernel_policy {
+    static constexpr swr::WithdrawalMethod wmethod     = W;
+    static constexpr swr::Flexibility      flexibility = F; // Only used by the STANDARD method
+    static constexpr swr::Rebalancing      rebalance   = R;
+
+    // The rarely used features (glidepath, social security, extra income, cash and
+    // withdrawal selection) are compiled out unless one of them is enabled
+    static constexpr bool extras = Extras;
+};
+
+// Indicates if the scenario uses one of the extra features of the policies
+bool uses_extras(const swr::scenario& scenario) {
+    return scenario.glidepath || scenario.social_security || scenario.extra_income || scenario.initial_cash > 0.0f
+           || scenario.wselection != swr::WithdrawalSelection::ALLOCATION;
+}
 
-        scenario.portfolio[0].allocation_ += scenario.gp_pass;
-        scenario.portfolio[1].allocation_ -= scenario.gp_pass;
+template <typename P>
+bool glidepath(const swr::scenario& scenario, swr::context& context, asset_array<float>& current_values, asset_array<float>& allocations) {
+    if constexpr (P::extras) {
+        if (scenario.glidepath) {
+            // Check if we have already reached the target
+            if (allocations[0] == scenario.gp_goal) {
+                return true;
+            }
 
-        // Acount for float inaccuracies
-        if (scenario.gp_pass > 0.0f && scenario.portfolio[0].allocation_ > scenario.gp_goal) {
-            scenario.portfolio[0].allocation_ = scenario.gp_goal;
-            scenario.portfolio[1].allocation_ = 100.0f - scenario.gp_goal;
-        } else if (scenario.gp_pass < 0.0f && scenario.portfolio[0].allocation_ < scenario.gp_goal) {
-            scenario.portfolio[0].allocation_ = scenario.gp_goal;
-            scenario.portfolio[1].allocation_ = 100.0f - scenario.gp_goal;
-        }
+            allocations[0] += scenario.gp_pass;
+            allocations[1] -= scenario.gp_pass;
 
-        // If rebalancing is not monthly, we do a rebalancing ourselves
-        // Otherwise, it will be done as the next step
-        if (scenario.rebalance == swr::Rebalancing::NONE) {
-            // Pay the fees
-            for (size_t i = 0; i < N; ++i) {
-                current_values[i] *= 1.0f - monthly_rebalancing_cost / 100.0f;
+            // Acount for float inaccuracies
+            if (scenario.gp_pass > 0.0f && allocations[0] > scenario.gp_goal) {
+                allocations[0] = scenario.gp_goal;
+                allocations[1] = 100.0f - scenario.gp_goal;
+            } else if (scenario.gp_pass < 0.0f && allocations[0] < scenario.gp_goal) {
+                allocations[0] = scenario.gp_goal;
+                allocations[1] = 100.0f - scenario.gp_goal;
             }
 
-            const auto total_value = current_value(current_values);
+            // If rebalancing is not monthly, we do a rebalancing ourselves
+            // Otherwise, it will be done as the next step
+            if constexpr (P::rebalance == swr::Rebalancing::NONE) {
+                const size_t n = current_values.size();
 
-            // Fees can cause failure
-            if (scenario.is_failure(context, total_value)) {
-                return false;
-            }
+                // Pay the fees
+                for (size_t i = 0; i < n; ++i) {
+                    current_values[i] *= 1.0f - monthly_rebalancing_cost / 100.0f;
+                }
+
+                const auto total_value = current_value(current_values);
 
-            for (size_t i = 0; i < N; ++i) {
-                current_values[i] = total_value * (scenario.portfolio[i].allocation_ / 100.0f);
+                // Fees can cause failure
+                if (scenario.is_failure(context, total_value)) {
+                    return false;
+                }
+
+                for (size_t i = 0; i < n; ++i) {
+                    current_values[i] = total_value * (allocations[i] / 100.0f);
+                }
             }
         }
     }
@@ -87,17 +161,15 @@ bool glidepath(swr::scenario& scenario, swr::context& context, std::array<float,
     return true;
 }
 
-template <size_t N>
-bool monthly_rebalance(const swr::scenario& scenario, swr::context& context, std::array<float, N>& current_values) {
-    // Nothing to rebalance if we have a single asset
-    if constexpr (N == 1) {
-        return true;
-    }
+// A single asset is never rebalanced, the policy of its kernel has no rebalancing
+template <typename P>
+bool monthly_rebalance(const swr::scenario& scenario, swr::context& context, asset_array<float>& current_values, const asset_array<float>& allocations) {
+    const size_t n = current_values.size();
 
     // Monthly Rebalance if necessary
-    if (scenario.rebalance == swr::Rebalancing::MONTHLY) {
+    if constexpr (P::rebalance == swr::Rebalancing::MONTHLY) {
         // Pay the fees
-        for (size_t i = 0; i < N; ++i) {
+        for (size_t i = 0; i < n; ++i) {
             current_values[i] *= 1.0f - monthly_rebalancing_cost / 100.0f;
         }
 
@@ -108,19 +180,19 @@ bool monthly_rebalance(const swr::scenario& scenario, swr::context& context, std
             return false;
         }
 
-        for (size_t i = 0; i < N; ++i) {
-            current_values[i] = total_value * (scenario.portfolio[i].allocation_ / 100.0f);
+        for (size_t i = 0; i < n; ++i) {
+            current_values[i] = total_value * (allocations[i] / 100.0f);
         }
     }
 
     // Threshold Rebalance if necessary
-    if (scenario.rebalance == swr::Rebalancing::THRESHOLD) {
+    if constexpr (P::rebalance == swr::Rebalancing::THRESHOLD) {
         bool rebalance = false;
 
         {
             const auto total_value = current_value(current_values);
-            for (size_t i = 0; i < N; ++i) {
-                if (std::abs((scenario.portfolio[i].allocation_ / 100.0f) - current_values[i] / total_value) >= scenario.threshold) {
+            for (size_t i = 0; i < n; ++i) {
+                if (std::abs((allocations[i] / 100.0f) - current_values[i] / total_value) >= scenario.threshold) {
                     rebalance = true;
                     break;
                 }
@@ -129,7 +201,7 @@ bool monthly_rebalance(const swr::scenario& scenario, swr::context& context, std
 
         if (rebalance) {
             // Pay the fees
-            for (size_t i = 0; i < N; ++i) {
+            for (size_t i = 0; i < n; ++i) {
                 current_values[i] *= 1.0f - threshold_rebalancing_cost / 100.0f;
             }
 
@@ -141,8 +213,8 @@ bool monthly_rebalance(const swr::scenario& scenario, swr::context& context, std
                 return false;
             }
 
-            for (size_t i = 0; i < N; ++i) {
-                current_values[i] = total_value * (scenario.portfolio[i].allocation_ / 100.0f);
+            for (size_t i = 0; i < n; ++i) {
+                current_values[i] = total_value * (allocations[i] / 100.0f);
             }
         }
     }
@@ -150,17 +222,14 @@ bool monthly_rebalance(const swr::scenario& scenario, swr::context& context, std
     return true;
 }
 
-template <size_t N>
-bool yearly_rebalance(const swr::scenario& scenario, swr::context& context, std::array<float, N>& current_values) {
-    // Nothing to rebalance if we have a single asset
-    if constexpr (N == 1) {
-        return true;
-    }
+template <typename P>
+bool yearly_rebalance(const swr::scenario& scenario, swr::context& context, asset_array<float>& current_values, const asset_array<float>& allocations) {
+    const size_t n = current_values.size();
 
     // Yearly Rebalance if necessary
-    if (scenario.rebalance == swr::Rebalancing::YEARLY) {
+    if constexpr (P::rebalance == swr::Rebalancing::YEARLY) {
         // Pay the fees
-        for (size_t i = 0; i < N; ++i) {
+        for (size_t i = 0; i < n; ++i) {
             current_values[i] *= 1.0f - yearly_rebalancing_cost / 100.0f;
         }
 
@@ -171,33 +240,28 @@ bool yearly_rebalance(const swr::scenario& scenario, swr::context& context, std:
             return false;
         }
 
-        for (size_t i = 0; i < N; ++i) {
-            current_values[i] = total_value * (scenario.portfolio[i].allocation_ / 100.0f);
+        for (size_t i = 0; i < n; ++i) {
+            current_values[i] = total_value * (allocations[i] / 100.0f);
         }
     }
 
     return true;
 }
 
-template <size_t N>
-bool pay_fees(const swr::scenario& scenario, swr::context& context, std::array<float, N>& current_values) {
+// The fee factor is 1 without fees, the failure check then gives the same
+// result as the previous one, so there is no need to branch on the fees
+bool pay_fees(const swr::scenario& scenario, swr::context& context, asset_array<float>& current_values, float fee_factor) {
     // Simulate TER
-    if (scenario.fees > 0.0f) {
-        for (size_t i = 0; i < N; ++i) {
-            current_values[i] *= 1.0f - (scenario.fees / 12.0f);
-        }
-
-        // TER can cause failure
-        if (scenario.is_failure(context, current_value(current_values))) {
-            return false;
-        }
+    for (size_t i = 0; i < current_values.size(); ++i) {
+        current_values[i] *= fee_factor;
     }
 
-    return true;
+    // TER can cause failure
+    return !scenario.is_failure(context, current_value(current_values));
 }
 
-template <size_t N>
-bool withdraw(const swr::scenario& scenario, swr::context& context, std::array<float, N>& current_values, const std::array<float, N>& market_values) {
+template <typename P>
+bool withdraw(const swr::scenario& scenario, swr::context& context, asset_array<float>& current_values, const asset_array<float>& market_values) {
     if ((context.months - 1) % scenario.withdraw_frequency == 0) {
         const auto total_value = current_value(current_values);
 
@@ -209,10 +273,10 @@ bool withdraw(const swr::scenario& scenario, swr::context& context, std::array<f
         float withdrawal_amount = 0;
 
         // Compute the withdrawal amount based on the withdrawal strategy
-        if (scenario.wmethod == swr::WithdrawalMethod::STANDARD) {
+        if constexpr (P::wmethod == swr::WithdrawalMethod::STANDARD) {
             withdrawal_amount = context.withdrawal / (12.0f / periods);
 
-            if (scenario.flexibility == swr::Flexibility::PORTFOLIO) {
+            if constexpr (P::flexibility == swr::Flexibility::PORTFOLIO) {
                 if (total_value < scenario.flexibility_threshold_2 * scenario.initial_value) {
                     withdrawal_amount *= scenario.flexibility_change_2;
                     context.flexible = true;
@@ -220,7 +284,7 @@ bool withdraw(const swr::scenario& scenario, swr::context& context, std::array<f
                     withdrawal_amount *= scenario.flexibility_change_1;
                     context.flexible = true;
                 }
-            } else if (scenario.flexibility == swr::Flexibility::MARKET) {
+            } else if constexpr (P::flexibility == swr::Flexibility::MARKET) {
                 const auto market_value = current_value(market_values);
 
                 if (market_value > context.hist_high) {
@@ -235,12 +299,12 @@ bool withdraw(const swr::scenario& scenario, swr::context& context, std::array<f
                     context.flexible = true;
                 }
             }
-        } else if (scenario.wmethod == swr::WithdrawalMethod::CURRENT) {
+        } else if constexpr (P::wmethod == swr::WithdrawalMethod::CURRENT) {
             withdrawal_amount = (total_value * (scenario.wr / 100.0f)) / (12.0f / periods);
 
             // Make sure, we don't go over the minimum
             withdrawal_amount = std::max(withdrawal_amount, context.minimum / (12.0f / periods));
-        } else if (scenario.wmethod == swr::WithdrawalMethod::DIE_WITH_ZERO) {
+        } else if constexpr (P::wmethod == swr::WithdrawalMethod::DIE_WITH_ZERO) {
             const auto year            = context.months / 12;
             const auto remaining_years = scenario.years - year;
             const auto base_withdrawal = remaining_years ? total_value / remaining_years : total_value;
@@ -262,7 +326,7 @@ bool withdraw(const swr::scenario& scenario, swr::context& context, std::array<f
             }
 
             withdrawal_amount = adjusted / (12.0f / periods);
-        } else if (scenario.wmethod == swr::WithdrawalMethod::VPW) {
+        } else if constexpr (P::wmethod == swr::WithdrawalMethod::VPW) {
             const auto year = context.months / 12;
             const auto n    = scenario.years - year;
 
@@ -282,7 +346,7 @@ bool withdraw(const swr::scenario& scenario, swr::context& context, std::array<f
             }
 
             withdrawal_amount = adjusted / (12.0f / periods);
-        } else if (scenario.wmethod == swr::WithdrawalMethod::VANGUARD) {
+        } else if constexpr (P::wmethod == swr::WithdrawalMethod::VANGUARD) {
             // Compute the withdrawal for the year
 
             if (context.months == 1) {
@@ -307,18 +371,20 @@ bool withdraw(const swr::scenario& scenario, swr::context& context, std::array<f
             withdrawal_amount = std::max(withdrawal_amount, context.minimum / (12.0f / periods));
         }
 
-        // Social security means we have less to withdraw
-        if (scenario.social_security) {
-            if ((context.months / 12.0f) >= scenario.social_delay) {
-                withdrawal_amount -= (scenario.social_coverage * withdrawal_amount);
-                withdrawal_amount -= scenario.social_amount / 12.0f;
+        if constexpr (P::extras) {
+            // Social security means we have less to withdraw
+            if (scenario.social_security) {
+                if ((context.months / 12.0f) >= scenario.social_delay) {
+                    withdrawal_amount -= (scenario.social_coverage * withdrawal_amount);
+                    withdrawal_amount -= scenario.social_amount / 12.0f;
+                }
             }
-        }
 
-        // Extra income (without delay) means we have less to withdraw
-        if (scenario.extra_income) {
-            withdrawal_amount -= scenario.extra_income_coverage * (scenario.initial_value * (scenario.wr / 100.0f) / (12.0f / periods));
-            withdrawal_amount -= scenario.extra_income_amount / 12.0f;
+            // Extra income (without delay) means we have less to withdraw
+            if (scenario.extra_income) {
+                withdrawal_amount -= scenario.extra_income_coverage * (scenario.initial_value * (scenario.wr / 100.0f) / (12.0f / periods));
+                withdrawal_amount -= scenario.extra_income_amount / 12.0f;
+            }
         }
 
         context.last_withdrawal_amount = withdrawal_amount;
@@ -328,40 +394,37 @@ bool withdraw(const swr::scenario& scenario, swr::context& context, std::array<f
             return true;
         }
 
-        auto eff_wr = withdrawal_amount / context.year_start_value;
-
-        // Strategies with cash
-        if (scenario.cash_simple || ((eff_wr * 100.0f) >= (scenario.wr / 12.0f))) {
-            // First, withdraw from cash if possible
-            if (context.cash > 0.0f) {
-                if (withdrawal_amount <= context.cash) {
-                    context.year_withdrawn += withdrawal_amount;
-                    context.cash -= withdrawal_amount;
-                    withdrawal_amount = 0.0f;
-                } else {
-                    context.year_withdrawn += context.cash;
-                    withdrawal_amount -= context.cash;
-                    context.cash = 0.0f;
+        if constexpr (P::extras) {
+            auto eff_wr = withdrawal_amount / context.year_start_value;
+
+            // Strategies with cash
+            if (scenario.cash_simple || ((eff_wr * 100.0f) >= (scenario.wr / 12.0f))) {
+                // First, withdraw from cash if possible
+                if (context.cash > 0.0f) {
+                    if (withdrawal_amount <= context.cash) {
+                        context.year_withdrawn += withdrawal_amount;
+                        context.cash -= withdrawal_amount;
+                        withdrawal_amount = 0.0f;
+                    } else {
+                        context.year_withdrawn += context.cash;
+                        withdrawal_amount -= context.cash;
+                        context.cash = 0.0f;
+                    }
                 }
-            }
 
-            // Check whether we reduced the withdrawal to zero
-            if (withdrawal_amount <= 0.0f) {
-                return true;
+                // Check whether we reduced the withdrawal to zero
+                if (withdrawal_amount <= 0.0f) {
+                    return true;
+                }
             }
         }
 
-        switch (scenario.wselection) {
-        case swr::WithdrawalSelection::ALLOCATION: {
+        if (!P::extras || scenario.wselection == swr::WithdrawalSelection::ALLOCATION) {
             for (auto& value : current_values) {
                 value = std::max(0.0f, value - (value / total_value) * withdrawal_amount);
             }
-            break;
-        }
-
-        case swr::WithdrawalSelection::STOCKS:
-            [[fallthrough]];
-        case swr::WithdrawalSelection::BONDS: {
+        } else {
+            // Withdraw only stocks or only bonds
             if (current_values[context.withdraw_index] > withdrawal_amount) {
                 current_values[context.withdraw_index] -= withdrawal_amount;
             } else {
@@ -371,7 +434,6 @@ bool withdraw(const swr::scenario& scenario, swr::context& context, std::array<f
                 current_values[other_index]            = std::max(0.0f, current_values[other_index] - leftover);
             }
         }
-        }
 
         // Check for failure after the withdrawal
         if (scenario.is_failure(context, current_value(current_values))) {
@@ -385,176 +447,166 @@ bool withdraw(const swr::scenario& scenario, swr::context& context, std::array<f
     return true;
 }
 
-template <size_t N>
-using data_vector_array = std::array<swr::data_vector::iterator, N>;
-
-template <size_t N>
-void swr_simulation_period(swr::results&              res,
-                           swr::scenario&             scenario,
-                           size_t                     withdraw_index,
-                           size_t                     current_year,
-                           size_t                     current_month,
-                           data_vector_array<N>       start_returns,
-                           data_vector_array<N>       start_exchanges,
-                           swr::data_vector::iterator start_inflation) {
-    data_vector_array<N> returns;
-    data_vector_array<N> exchanges;
-
-    res.spending.emplace_back();
+// The series of a simulation, from its first month
+// The returns of an asset with exchange rates are fused with them once, before
+// the simulation, instead of multiplying both in every period
+struct series_set {
+    std::vector<const float*>  returns; // Returns of each asset (with its exchange rates)
+    const float*               inflation = nullptr;
+    std::vector<swr::series>   fused;   // Storage of the fused returns (the pointers stay valid when moved)
+};
+
+// Pointer to the value of the given month inside the series
+const float* series_start(const swr::data_vector& values, size_t year, size_t month) {
+    return &swr::get_start(values, year, month)->value;
+}
 
-    swr::context context;
-    context.months         = 1;
-    context.total_months   = scenario.years * 12;
-    context.withdraw_index = withdraw_index;
+// The series of the scenario, from the first month of its start year
+series_set scenario_series(const swr::scenario& scenario) {
+    const size_t n      = scenario.portfolio.size();
+    const auto&  market = *scenario.market;
 
-    // The amount of money withdrawn per year (STANDARD method)
-    context.withdrawal = scenario.initial_value * (scenario.wr / 100.0f);
+    series_set series;
+    series.fused.reserve(n);
 
-    // The minimum amount of money withdraw (CURRENT method)
-    context.minimum = scenario.initial_value * scenario.minimum;
+    for (size_t i = 0; i < n; ++i) {
+        const auto& values  = *market.values[i];
+        auto        returns = swr::get_start(values, scenario.start_year, 1);
 
-    // The amount of cash available
-    context.cash = scenario.initial_cash;
+        // Without exchange rates, the returns are used in place
+        if (!market.exchange_set[i]) {
+            series.returns.push_back(&returns->value);
+            continue;
+        }
 
-    // Used for the target threshold
-    context.target_value_ = scenario.initial_value;
+        const auto& exchange_rates = *market.exchange_rates[i];
+        auto        exchanges      = swr::get_start(exchange_rates, scenario.start_year, 1);
 
-    // Use for Die With Zero
-    context.dwz_floor   = scenario.dwz_floor;
-    context.dwz_ceiling = scenario.dwz_ceiling;
+        const size_t months = std::min(values.end() - returns, exchange_rates.end() - exchanges);
 
-    const size_t end_year  = current_year + (current_month - 1 + context.total_months - 1) / 12;
-    const size_t end_month = 1 + ((current_month - 1) + (context.total_months - 1) % 12) % 12;
+        auto& fused = series.fused.emplace_back(months);
+        for (size_t m = 0; m < months; ++m) {
+            fused[m] = returns[m].value * exchanges[m].value;
+        }
 
-    // Reset the allocation for the context
-    for (auto& asset : scenario.portfolio) {
-        asset.allocation_ = asset.allocation;
+        series.returns.push_back(fused.data());
     }
 
-    std::array<float, N> current_values{};
-    std::array<float, N> market_values{};
-
-    // Compute the initial values of the assets
-    for (size_t i = 0; i < N; ++i) {
-        current_values[i] = scenario.initial_value * (scenario.portfolio[i].allocation_ / 100.0f);
-        market_values[i]  = scenario.initial_value * (scenario.portfolio[i].allocation_ / 100.0f);
-        returns[i]        = start_returns[i]++;
-        exchanges[i]      = start_exchanges[i]++;
-    }
+    series.inflation = series_start(*market.inflation_data, scenario.start_year, 1);
 
-    auto inflation = start_inflation++;
+    return series;
+}
 
-    float total_withdrawn = 0.0f;
-    bool  failure         = false;
+// The outcome of the simulation of one period
+struct period_outcome {
+    size_t current_year  = 0;
+    size_t current_month = 0;
 
-    auto step = [&](auto result) {
-        if (!failure && !result()) {
-            failure = true;
-            res.record_failure(context.months, current_month, current_year);
-        }
-    };
+    bool   failure        = false;
+    size_t failure_months = 0; // Number of months before the failure
+    size_t failure_year   = 0; // Year of the failure
+    float  failure_eff_wr = 0; // Effective withdrawal rate of the year of the failure
 
-    for (size_t y = current_year; y <= end_year; ++y) {
-        context.year_start_value = current_value(current_values);
-        context.year_withdrawn   = 0.0f;
+    bool  flexible        = false;
+    float final_value     = 0.0f;
+    float total_withdrawn = 0.0f;
 
-        size_t m = 0;
-        for (m = (y == current_year ? current_month : 1); !failure && m <= (y == end_year ? end_month : 12); ++m, ++context.months) {
-            // Adjust the portfolio with the returns and exchanges
-            for (size_t i = 0; i < N; ++i) {
-                current_values[i] *= returns[i]->value;
-                current_values[i] *= exchanges[i]->value;
+    std::vector<float> spending; // Spending of each year
+};
 
-                market_values[i] *= returns[i]->value;
-                market_values[i] *= exchanges[i]->value;
+// Accumulate the terminal value and the spending of one period in the distributions
+// The distributions do not depend on the order of the periods
+template <swr::Statistics S>
+void record_distributions(swr::results& res, const period_outcome& outcome) {
+    if constexpr (S == swr::Statistics::SUCCESS) {
+        return;
+    }
 
-                ++returns[i];
-                ++exchanges[i];
-            }
+    res.tv_statistics.push(outcome.final_value);
 
-            // Stock market losses can cause failure
-            step([&]() { return !scenario.is_failure(context, current_value(current_values)); });
+    if (outcome.failure) {
+        return;
+    }
 
-            // Glidepath
-            step([&]() { return glidepath(scenario, context, current_values); });
+    const auto& yearly = outcome.spending;
 
-            // Monthly Rebalance
-            step([&]() { return monthly_rebalance(scenario, context, current_values); });
+    res.spending_statistics.push(std::accumulate(yearly.begin(), yearly.end(), 0.0f));
 
-            // Simulate TER
-            step([&]() { return pay_fees(scenario, context, current_values); });
+    for (size_t y = 1; y < yearly.size(); ++y) {
+        if (yearly[y] >= 1.5f * yearly[0]) {
+            ++res.years_large_spending;
+        }
 
-            // Adjust the withdrawals for inflation
-            context.withdrawal *= inflation->value;
-            context.dwz_ceiling *= inflation->value;
-            context.dwz_floor *= inflation->value;
-            context.minimum *= inflation->value;
-            context.target_value_ *= inflation->value;
-            ++inflation;
+        if (yearly[y] <= 0.5f * yearly[0]) {
+            ++res.years_small_spending;
+        }
 
-            // Monthly withdrawal
-            step([&]() { return withdraw(scenario, context, current_values, market_values); });
+        if (yearly[y] >= 1.1f * yearly[y - 1]) {
+            ++res.years_volatile_up_spending;
+        }
 
-            // Record spending
-            if ((context.months - 1) % 12 == 0) {
-                res.spending.back().push_back(context.last_withdrawal_amount);
-            } else {
-                res.spending.back().back() += context.last_withdrawal_amount;
-            }
+        if (yearly[y] <= 0.9f * yearly[y - 1]) {
+            ++res.years_volatile_down_spending;
         }
+    }
+}
 
-        total_withdrawn += context.year_withdrawn;
+// Accumulate the outcome of one period in the results, except for the distributions
+// The periods must be recorded in order for the tie breaks to be stable
+template <swr::Statistics S>
+void record_ordered(swr::results& res, period_outcome& outcome) {
+    const auto current_year  = outcome.current_year;
+    const auto current_month = outcome.current_month;
+    const auto final_value   = outcome.final_value;
 
-        // Yearly Rebalance and check for failure
-        step([&]() { return yearly_rebalance(scenario, context, current_values); });
+    if (outcome.failure) {
+        res.record_failure(outcome.failure_months, current_month, current_year);
 
         // Record effective withdrawal rates
 
-        if (failure) {
-            auto eff_wr = context.year_withdrawn / context.year_start_value;
-
-            if (!res.lowest_eff_wr_year || eff_wr < res.lowest_eff_wr) {
-                res.lowest_eff_wr_start_year  = current_year;
-                res.lowest_eff_wr_start_month = current_month;
-                res.lowest_eff_wr_year        = y;
-                res.lowest_eff_wr             = eff_wr;
-            }
+        const auto eff_wr = outcome.failure_eff_wr;
 
-            if (!res.highest_eff_wr_year || eff_wr > res.highest_eff_wr) {
-                res.highest_eff_wr_start_year  = current_year;
-                res.highest_eff_wr_start_month = current_month;
-                res.highest_eff_wr_year        = y;
-                res.highest_eff_wr             = eff_wr;
-            }
+        if (!res.lowest_eff_wr_year || eff_wr < res.lowest_eff_wr) {
+            res.lowest_eff_wr_start_year  = current_year;
+            res.lowest_eff_wr_start_month = current_month;
+            res.lowest_eff_wr_year        = outcome.failure_year;
+            res.lowest_eff_wr             = eff_wr;
+        }
 
-            break;
+        if (!res.highest_eff_wr_year || eff_wr > res.highest_eff_wr) {
+            res.highest_eff_wr_start_year  = current_year;
+            res.highest_eff_wr_start_month = current_month;
+            res.highest_eff_wr_year        = outcome.failure_year;
+            res.highest_eff_wr             = eff_wr;
         }
-    }
 
-    const auto final_value = failure ? 0.0f : current_value(current_values);
+        ++res.failures;
 
-    if (!failure) {
+        if (outcome.flexible) {
+            ++res.flexible_failures;
+        }
+    } else {
         ++res.successes;
 
-        if (context.flexible) {
+        if (outcome.flexible) {
             ++res.flexible_successes;
         }
 
         // Total amount of money withdrawn
-        res.total_withdrawn += total_withdrawn;
-    } else {
-        ++res.failures;
+        res.total_withdrawn += outcome.total_withdrawn;
 
-        if (context.flexible) {
-            ++res.flexible_failures;
+        if constexpr (S == swr::Statistics::FULL) {
+            res.spending.emplace_back(std::move(outcome.spending));
         }
     }
 
-    res.terminal_values.push_back(final_value);
-    res.flexible.push_back(context.flexible ? 1.0f : 0.0f);
+    if constexpr (S == swr::Statistics::SUCCESS) {
+        return;
+    }
 
-    if (failure) {
-        res.spending.pop_back();
+    if constexpr (S == swr::Statistics::FULL) {
+        res.terminal_values.push_back(final_value);
+        res.flexible.push_back(outcome.flexible ? 1.0f : 0.0f);
     }
 
     // Record periods
@@ -584,253 +636,1432 @@ void swr_simulation_period(swr::results&              res,
     }
 }
 
-template <size_t N>
-swr::results swr_simulation_inside(swr::results& res, swr::scenario& scenario, size_t withdraw_index) {
-    auto start_tp = chr::high_resolution_clock::now();
+// Accumulate the outcome of one period in the results
+template <swr::Statistics S>
+void record_period(swr::results& res, period_outcome& outcome) {
+    record_distributions<S>(res, outcome);
+    record_ordered<S>(res, outcome);
+}
 
-    auto& inflation_data = scenario.inflation_data;
-    auto& values         = scenario.values;
-    auto& exchange_rates = scenario.exchange_rates;
+// The outcomes of a chunk of periods simulated by one thread
+// The distributions are accumulated by the thread, the other results are
+// recorded later, in order
+struct chunk_outcomes {
+    std::vector<period_outcome> outcomes;
+    swr::results                distributions;
+};
+
+// Keep the outcome of one period, to be recorded later in the results
+template <swr::Statistics S>
+void record_period(chunk_outcomes& chunk, period_outcome& outcome) {
+    record_distributions<S>(chunk.distributions, outcome);
+
+    if constexpr (S != swr::Statistics::FULL) {
+        outcome.spending = {};
+    }
 
-    // Prepare the starting points (for efficiency)
-    data_vector_array<N> start_returns;
-    data_vector_array<N> start_exchanges;
+    chunk.outcomes.emplace_back(std::move(outcome));
+}
 
-    for (size_t i = 0; i < N; ++i) {
-        start_returns[i]   = swr::get_start(values[i], scenario.start_year, 1);
-        start_exchanges[i] = swr::get_start(exchange_rates[i], scenario.start_year, 1);
-    }
+// Keep the outcome of a single period
+template <swr::Statistics S>
+void record_period(period_outcome& out, period_outcome& outcome) {
+    out = std::move(outcome);
+}
 
-    auto start_inflation = swr::get_start(inflation_data, scenario.start_year, 1);
+// Simulate with the scalar kernel of the given policy the period starting at the given month of the series
+// A bootstrapped period starts at the first month and reads each year from the sampled year of its path
+// The spending of each year is only recorded if Spending is true
+template <bool Spending, typename P>
+period_outcome swr_simulation_period(const swr::scenario& scenario, size_t withdraw_index, const series_set& series, size_t first, const size_t* path) {
+    const size_t n = scenario.portfolio.size();
 
-    // 3. Do the actual simulation
+    const size_t current_year  = scenario.start_year + first / 12;
+    const size_t current_month = 1 + first % 12;
 
-    if (scenario.simulation == swr::Simulation::BACKTESTING) {
-        res.terminal_values.reserve(((scenario.end_year - scenario.start_year) - scenario.years) * 12);
+    asset_array<const float*> returns(n);
 
-        for (size_t current_year = scenario.start_year; current_year <= scenario.end_year - scenario.years; ++current_year) {
-            for (size_t current_month = 1; current_month <= 12; ++current_month) {
-                swr_simulation_period<N>(res, scenario, withdraw_index, current_year, current_month, start_returns, start_exchanges, start_inflation);
+    period_outcome outcome;
+    outcome.current_year  = current_year;
+    outcome.current_month = current_month;
 
-                // After each starting point, we check if we should timeout
+    swr::context context;
+    context.months         = 1;
+    context.total_months   = scenario.years * 12;
+    context.withdraw_index = withdraw_index;
 
-                if (scenario.timeout_msecs) {
-                    auto stop_tp  = chr::high_resolution_clock::now();
-                    auto duration = chr::duration_cast<chr::milliseconds>(stop_tp - start_tp).count();
+    // The amount of money withdrawn per year (STANDARD method)
+    context.withdrawal = scenario.initial_value * (scenario.wr / 100.0f);
 
-                    if (std::cmp_greater(duration, scenario.timeout_msecs)) {
-                        res.message = "The computation took too long";
-                        res.error   = true;
-                        std::cout << "ERROR: Timeout after " << duration << "ms\n";
-                        return res;
-                    }
-                }
+    // The minimum amount of money withdraw (CURRENT method)
+    context.minimum = scenario.initial_value * scenario.minimum;
 
-                // Go to the next round of data
+    // The amount of cash available
+    context.cash = scenario.initial_cash;
 
-                for (size_t i = 0; i < N; ++i) {
-                    ++start_returns[i];
-                    ++start_exchanges[i];
-                }
+    // Used for the target threshold
+    context.target_value_ = scenario.initial_value;
 
-                ++start_inflation;
-            }
-        }
-    } else if (scenario.simulation == swr::Simulation::BOOTSTRAPPING) {
-        res.terminal_values.reserve(scenario.simulations);
+    // Use for Die With Zero
+    context.dwz_floor   = scenario.dwz_floor;
+    context.dwz_ceiling = scenario.dwz_ceiling;
 
-        std::random_device                    rd;
-        std::default_random_engine            g(rd());
-        std::uniform_int_distribution<size_t> dist(scenario.start_year, scenario.end_year);
+    const size_t end_year  = current_year + (current_month - 1 + context.total_months - 1) / 12;
+    const size_t end_month = 1 + ((current_month - 1) + (context.total_months - 1) % 12) % 12;
 
-        auto overwrite_year = [](auto left, auto right) {
-            for (size_t i = 0; i < 12; ++i) {
-                right->value = left->value;
-                ++left;
-                ++right;
-            }
-        };
+    // The current allocation, the glidepath changes it during the period
+    asset_array<float> allocations(n);
+    for (size_t i = 0; i < n; ++i) {
+        allocations[i] = scenario.portfolio[i].allocation;
+    }
 
-        // Create copies of all data
-        auto copy_inflation_data = scenario.inflation_data;
-        auto copy_values         = scenario.values;
-        auto copy_exchange_rates = scenario.exchange_rates;
+    asset_array<float> current_values(n);
+    asset_array<float> market_values(n);
 
-        data_vector_array<N> copy_start_returns;
-        data_vector_array<N> copy_start_exchanges;
+    // Compute the initial values of the assets
+    for (size_t i = 0; i < n; ++i) {
+        current_values[i] = scenario.initial_value * (allocations[i] / 100.0f);
+        market_values[i]  = scenario.initial_value * (allocations[i] / 100.0f);
+        returns[i]        = series.returns[i] + first;
+    }
 
-        // Get an iterator to the data of the copy
+    auto inflation = series.inflation + first;
 
-        for (size_t i = 0; i < N; ++i) {
-            copy_start_returns[i]   = copy_values[i].begin();
-            copy_start_exchanges[i] = copy_exchange_rates[i].begin();
-        }
+    const float fee_factor = scenario.fees > 0.0f ? 1.0f - (scenario.fees / 12.0f) : 1.0f;
 
-        const auto copy_start_inflation = copy_inflation_data.begin();
+    float total_withdrawn = 0.0f;
+    bool  failure         = false;
 
-        for (size_t simulation = 0; simulation < scenario.simulations; ++simulation) {
-            for (size_t year = 0; year < scenario.years; ++year) {
-                const size_t replacement_year = dist(g);
+    auto step = [&](auto result) {
+        if (!failure && !result()) {
+            failure                = true;
+            outcome.failure_months = context.months;
+        }
+    };
 
-                for (size_t i = 0; i < N; ++i) {
-                    auto replacement_returns = swr::get_start_hint(start_returns[i], scenario.values[i], replacement_year, 1);
-                    overwrite_year(replacement_returns, copy_start_returns[i] + year * 12);
+    for (size_t y = current_year; y <= end_year; ++y) {
+        context.year_start_value = current_value(current_values);
+        context.year_withdrawn   = 0.0f;
 
-                    auto replacement_exchanges = swr::get_start_hint(start_exchanges[i], scenario.exchange_rates[i], replacement_year, 1);
-                    overwrite_year(replacement_exchanges, copy_start_exchanges[i] + year * 12);
-                }
+        // A bootstrapped path reads each year in place from the sampled year
+        if (path) {
+            const size_t offset = 12 * path[y - current_year];
 
-                auto replacement_inflation = swr::get_start_hint(start_inflation, scenario.inflation_data, replacement_year, 1);
-                overwrite_year(replacement_inflation, copy_start_inflation + year * 12);
+            for (size_t i = 0; i < n; ++i) {
+                returns[i] = series.returns[i] + offset;
             }
 
-            swr_simulation_period<N>(res, scenario, withdraw_index, scenario.start_year, 1, copy_start_returns, copy_start_exchanges, copy_start_inflation);
+            inflation = series.inflation + offset;
         }
-    } else if (scenario.simulation == swr::Simulation::MONTE_CARLO) {
-        res.terminal_values.reserve(scenario.simulations);
-
-        auto mean_data = [&scenario](const auto& data) {
-            float mean = 0.0f;
-            size_t count = 0;
-            for (auto x : data) {
-                if (x.year >= scenario.start_year && x.year <= scenario.end_year) {
-                    mean += std::log(x.value);
-                    ++count;
-                }
-            }
-            return mean / count;
-        };
 
-        auto stddev_data = [&scenario](const auto& data, float mean) {
-            float std = 0.0f;
-            size_t count = 0;
-            for (auto x : data) {
-                if (x.year >= scenario.start_year && x.year <= scenario.end_year) {
-                    std += (std::log(x.value) - mean) * (std::log(x.value) - mean);
-                    ++count;
+        size_t m = 0;
+        for (m = (y == current_year ? current_month : 1); !failure && m <= (y == end_year ? end_month : 12); ++m, ++context.months) {
+            // Adjust the portfolio with the returns (and exchanges)
+            for (size_t i = 0; i < n; ++i) {
+                current_values[i] *= *returns[i];
+
+                // The market values are only used by the market flexibility
+                if constexpr (P::flexibility == swr::Flexibility::MARKET) {
+                    market_values[i] *= *returns[i];
                 }
+
+                ++returns[i];
             }
-            return std::sqrt(std / count);
-        };
 
-        auto mean_inflation = mean_data(scenario.inflation_data);
-        auto stdd_inflation = stddev_data(scenario.inflation_data, mean_inflation);
+            // Stock market losses can cause failure
+            step([&]() { return !scenario.is_failure(context, current_value(current_values)); });
+
+            // Glidepath
+            step([&]() { return glidepath<P>(scenario, context, current_values, allocations); });
 
-        std::array<float, N> mean_returns{};
-        std::array<float, N> stdd_returns{};
+            // Monthly Rebalance
+            step([&]() { return monthly_rebalance<P>(scenario, context, current_values, allocations); });
 
-        std::array<float, N> mean_exchange_rates{};
-        std::array<float, N> stdd_exchange_rates{};
+            // Simulate TER
+            step([&]() { return pay_fees(scenario, context, current_values, fee_factor); });
 
-        for (size_t i = 0; i < N; ++i) {
-            mean_returns[i] = mean_data(scenario.values[i]);
-            stdd_returns[i] = stddev_data(scenario.values[i], mean_returns[i]);
+            // Adjust the withdrawals for inflation
+            context.withdrawal *= *inflation;
+            context.dwz_ceiling *= *inflation;
+            context.dwz_floor *= *inflation;
+            context.minimum *= *inflation;
+            context.target_value_ *= *inflation;
+            ++inflation;
 
-            mean_exchange_rates[i] = mean_data(scenario.exchange_rates[i]);
-            stdd_exchange_rates[i] = stddev_data(scenario.values[i], mean_exchange_rates[i]);
-        }
+            // Monthly withdrawal
+            step([&]() { return withdraw<P>(scenario, context, current_values, market_values); });
 
-        std::random_device         rd;
-        std::default_random_engine g(rd());
+            // Record spending
+            if constexpr (Spending) {
+                if ((context.months - 1) % 12 == 0) {
+                    outcome.spending.push_back(context.last_withdrawal_amount);
+                } else {
+                    outcome.spending.back() += context.last_withdrawal_amount;
+                }
+            }
+        }
 
-        std::normal_distribution<float> dist_inflation(mean_inflation, stdd_inflation);
+        total_withdrawn += context.year_withdrawn;
 
-        std::array<std::normal_distribution<float>, N> dist_returns{};
-        std::array<std::normal_distribution<float>, N> dist_exchange_rates{};
+        // Yearly Rebalance and check for failure
+        step([&]() { return yearly_rebalance<P>(scenario, context, current_values, allocations); });
 
-        for (size_t i = 0; i < N; ++i) {
-            dist_returns[i]        = std::normal_distribution<float>(mean_returns[i], stdd_returns[i]);
-            dist_exchange_rates[i] = std::normal_distribution<float>(mean_exchange_rates[i], stdd_exchange_rates[i]);
+        if (failure) {
+            outcome.failure_year   = y;
+            outcome.failure_eff_wr = context.year_withdrawn / context.year_start_value;
+            break;
         }
+    }
 
-        // Create copies of all data
-        auto copy_inflation_data = scenario.inflation_data;
-        auto copy_values         = scenario.values;
-        auto copy_exchange_rates = scenario.exchange_rates;
+    outcome.failure         = failure;
+    outcome.flexible        = context.flexible;
+    outcome.final_value     = failure ? 0.0f : current_value(current_values);
+    outcome.total_withdrawn = total_withdrawn;
 
-        data_vector_array<N> copy_start_returns;
-        data_vector_array<N> copy_start_exchanges;
+    return outcome;
+}
 
-        // Get an iterator to the data of the copy
+// The scalar kernel of one policy
+using period_kernel = period_outcome (*)(const swr::scenario&, size_t, const series_set&, size_t, const size_t*);
 
-        for (size_t i = 0; i < N; ++i) {
-            copy_start_returns[i]   = copy_values[i].begin();
-            copy_start_exchanges[i] = copy_exchange_rates[i].begin();
-        }
+template <bool Spending, swr::WithdrawalMethod W, swr::Flexibility F, swr::Rebalancing R>
+period_kernel select_kernel(const swr::scenario& scenario) {
+    if (uses_extras(scenario)) {
+        return &swr_simulation_period<Spending, kernel_policy<W, F, R, true>>;
+    }
 
-        const auto copy_start_inflation = copy_inflation_data.begin();
+    return &swr_simulation_period<Spending, kernel_policy<W, F, R, false>>;
+}
 
-        for (size_t simulation = 0; simulation < scenario.simulations; ++simulation) {
-            for (size_t month = 0; month < scenario.years * 12; ++month) {
-                const float log_inflation        = dist_inflation(g);
-                copy_inflation_data[month].value = std::exp(log_inflation);
+template <bool Spending, swr::WithdrawalMethod W, swr::Flexibility F>
+period_kernel select_kernel(const swr::scenario& scenario) {
+    // Nothing to rebalance if we have a single asset
+    if (scenario.portfolio.size() == 1) {
+        return select_kernel<Spending, W, F, swr::Rebalancing::NONE>(scenario);
+    }
 
-                for (size_t i = 0; i < N; ++i) {
-                    const float log_returns     = dist_returns[i](g);
-                    copy_values[i][month].value = std::exp(log_returns);
+    switch (scenario.rebalance) {
+    case swr::Rebalancing::MONTHLY:
+        return select_kernel<Spending, W, F, swr::Rebalancing::MONTHLY>(scenario);
+    case swr::Rebalancing::YEARLY:
+        return select_kernel<Spending, W, F, swr::Rebalancing::YEARLY>(scenario);
+    case swr::Rebalancing::THRESHOLD:
+        return select_kernel<Spending, W, F, swr::Rebalancing::THRESHOLD>(scenario);
+    case swr::Rebalancing::NONE:
+        break;
+    }
 
-                    if (scenario.exchange_set[i]) {
-                        const float log_exchange_rates      = dist_exchange_rates[i](g);
-                        copy_exchange_rates[i][month].value = std::exp(log_exchange_rates);
-                    }
-                }
-            }
+    return select_kernel<Spending, W, F, swr::Rebalancing::NONE>(scenario);
+}
 
-            swr_simulation_period<N>(res, scenario, withdraw_index, scenario.start_year, 1, copy_start_returns, copy_start_exchanges, copy_start_inflation);
+template <bool Spending, swr::WithdrawalMethod W>
+period_kernel select_kernel(const swr::scenario& scenario) {
+    // The flexibility is only used by the STANDARD method
+    if constexpr (W == swr::WithdrawalMethod::STANDARD) {
+        switch (scenario.flexibility) {
+        case swr::Flexibility::PORTFOLIO:
+            return select_kernel<Spending, W, swr::Flexibility::PORTFOLIO>(scenario);
+        case swr::Flexibility::MARKET:
+            return select_kernel<Spending, W, swr::Flexibility::MARKET>(scenario);
+        case swr::Flexibility::NONE:
+            break;
         }
-    } else {
-        res.error   = true;
-        res.message = "Invalid simulation method";
-        return res;
     }
 
-    res.withdrawn_per_year = (res.total_withdrawn / scenario.years) / static_cast<float>(res.successes);
-
-    res.highest_eff_wr *= 100.0f;
-    res.lowest_eff_wr *= 100.0f;
-
-    res.success_rate = 100 * (res.successes / static_cast<float>(res.successes + res.failures));
-    res.compute_terminal_values(res.terminal_values);
-    res.compute_spending(res.spending, scenario.years);
+    return select_kernel<Spending, W, swr::Flexibility::NONE>(scenario);
+}
 
-    simulations += res.terminal_values.size();
+// Select the scalar kernel of the configuration of the scenario
+// The configuration is only read here, once per simulation
+template <bool Spending>
+period_kernel select_kernel(const swr::scenario& scenario) {
+    switch (scenario.wmethod) {
+    case swr::WithdrawalMethod::CURRENT:
+        return select_kernel<Spending, swr::WithdrawalMethod::CURRENT>(scenario);
+    case swr::WithdrawalMethod::VANGUARD:
+        return select_kernel<Spending, swr::WithdrawalMethod::VANGUARD>(scenario);
+    case swr::WithdrawalMethod::DIE_WITH_ZERO:
+        return select_kernel<Spending, swr::WithdrawalMethod::DIE_WITH_ZERO>(scenario);
+    case swr::WithdrawalMethod::VPW:
+        return select_kernel<Spending, swr::WithdrawalMethod::VPW>(scenario);
+    case swr::WithdrawalMethod::STANDARD:
+        break;
+    }
 
-    return res;
+    return select_kernel<Spending, swr::WithdrawalMethod::STANDARD>(scenario);
 }
 
-template <size_t N>
-swr::results swr_simulation(swr::scenario& scenario) {
-    auto& inflation_data = scenario.inflation_data;
-    auto& values         = scenario.values;
-    auto& exchange_rates = scenario.exchange_rates;
+// Number of starting periods simulated at once by the lane kernel (one AVX2 register of floats)
+constexpr size_t simulation_lanes = 8;
 
-    // The final results
-    swr::results res;
+template <size_t L>
+using lane_array = std::array<float, L>;
 
-    // For compatibility, we set up exchange_rates and exchange_sets
+// Indicates if the scenario can be simulated by the lane kernel
+// The other configurations need per-period state and use the scalar kernel
+bool lanes_compatible(const swr::scenario& scenario) {
+    return scenario.simulation == swr::Simulation::BACKTESTING
+           && (scenario.wmethod == swr::WithdrawalMethod::STANDARD || scenario.wmethod == swr::WithdrawalMethod::CURRENT)
+           && scenario.wselection == swr::WithdrawalSelection::ALLOCATION && scenario.flexibility == swr::Flexibility::NONE && !scenario.glidepath
+           && scenario.initial_cash == 0.0f;
+}
 
-    if (scenario.exchange_set.empty() || exchange_rates.empty()) {
-        res.message = "Invalid scenario (no exchange rates)";
-        res.error   = true;
-        return res;
+// Simulate L consecutive starting months at once
+// Each lane is one starting period, lane l starting l months after the first one. Since the
+// lanes are contiguous, the returns of all lanes for one month are contiguous in the series
+// and the lane loops can be vectorized by the compiler. The lanes that failed keep being
+// computed but their values are not used anymore.
+template <size_t L, swr::Statistics S, typename Output>
+void swr_simulation_lanes(Output& res, const swr::scenario& scenario, size_t first_period, const series_set& series) {
+    const size_t n            = scenario.portfolio.size();
+    const size_t total_months = scenario.years * 12;
+
+    std::array<period_outcome, L> outcomes;
+    std::array<bool, L>           failure{};
+    std::array<bool, L>           mask{};
+
+    asset_array<lane_array<L>> current_values(n);
+    lane_array<L>              total_values;
+    lane_array<L>              withdrawal;
+    lane_array<L>              minimum;
+    lane_array<L>              target_value;
+    lane_array<L>              year_start_value{};
+    lane_array<L>              year_withdrawn{};
+    lane_array<L>              last_withdrawal_amount{};
+    lane_array<L>              total_withdrawn{};
+
+    for (size_t l = 0; l < L; ++l) {
+        outcomes[l].current_year  = scenario.start_year + (first_period + l) / 12;
+        outcomes[l].current_month = 1 + (first_period + l) % 12;
+
+        withdrawal[l]   = scenario.initial_value * (scenario.wr / 100.0f);
+        minimum[l]      = scenario.initial_value * scenario.minimum;
+        target_value[l] = scenario.initial_value;
     }
 
-    // 0. Make sure the years make some sense
-
-    if (scenario.start_year >= scenario.end_year) {
-        res.message = "The end year must be higher than the start year";
-        res.error   = true;
-        return res;
+    for (size_t i = 0; i < n; ++i) {
+        current_values[i].fill(scenario.initial_value * (scenario.portfolio[i].allocation / 100.0f));
     }
 
-    if (!scenario.years) {
-        res.message = "The number of years must be at least 1";
-        res.error   = true;
-        return res;
-    }
+    auto compute_totals = [&]() {
+        total_values.fill(0.0f);
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t l = 0; l < L; ++l) {
+                total_values[l] += current_values[i][l];
+            }
+        }
+    };
 
-    // 1. Adapt the start and end year with inflation and stocks
-    // Note: the data is already normalized so we do not have to check for stat
+    // Mark the failure of the lanes, only the first failure of a lane counts
+    auto check_failures = [&](size_t months, size_t t) {
+        const bool end = months == total_months;
+        for (size_t l = 0; l < L; ++l) {
+            if (!failure[l] && scenario.is_failure(end, target_value[l], total_values[l])) {
+                failure[l]                 = true;
+                outcomes[l].failure_months = months;
+                outcomes[l].failure_year   = scenario.start_year + (first_period + l + t) / 12;
+                outcomes[l].failure_eff_wr = year_withdrawn[l] / year_start_value[l];
+            }
+        }
+    };
+
+    // Rebalance the lanes in the mask, paying the given fees
+    auto rebalance = [&](float cost, size_t months, size_t t) {
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t l = 0; l < L; ++l) {
+                current_values[i][l] = mask[l] ? current_values[i][l] * (1.0f - cost / 100.0f) : current_values[i][l];
+            }
+        }
+
+        compute_totals();
+
+        const bool end = months == total_months;
+        for (size_t l = 0; l < L; ++l) {
+            if (mask[l] && !failure[l] && scenario.is_failure(end, target_value[l], total_values[l])) {
+                failure[l]                 = true;
+                outcomes[l].failure_months = months;
+                outcomes[l].failure_year   = scenario.start_year + (first_period + l + t) / 12;
+                outcomes[l].failure_eff_wr = year_withdrawn[l] / year_start_value[l];
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t l = 0; l < L; ++l) {
+                current_values[i][l] = mask[l] ? total_values[l] * (scenario.portfolio[i].allocation / 100.0f) : current_values[i][l];
+            }
+        }
+    };
+
+    for (size_t t = 0; t < total_months; ++t) {
+        const size_t months = t + 1;
+
+        // Start of the year of the lanes (the previous month was the end of their year)
+        if (t == 0 || std::ranges::any_of(mask, [](bool m) { return m; })) {
+            compute_totals();
+
+            for (size_t l = 0; l < L; ++l) {
+                if (t == 0 || mask[l]) {
+                    year_start_value[l] = total_values[l];
+                    year_withdrawn[l]   = 0.0f;
+                }
+            }
+        }
+
+        // Adjust the portfolio with the returns (and exchanges)
+        for (size_t i = 0; i < n; ++i) {
+            const float* returns = series.returns[i] + first_period + t;
+
+            for (size_t l = 0; l < L; ++l) {
+                current_values[i][l] *= returns[l];
+            }
+        }
+
+        compute_totals();
+
+        // Stock market losses can cause failure
+        check_failures(months, t);
+
+        // Monthly Rebalance
+        if (n > 1) {
+            if (scenario.rebalance == swr::Rebalancing::MONTHLY) {
+                mask.fill(true);
+                rebalance(monthly_rebalancing_cost, months, t);
+            } else if (scenario.rebalance == swr::Rebalancing::THRESHOLD) {
+                compute_totals();
+
+                for (size_t l = 0; l < L; ++l) {
+                    mask[l] = false;
+                    for (size_t i = 0; i < n; ++i) {
+                        if (std::abs((scenario.portfolio[i].allocation / 100.0f) - current_values[i][l] / total_values[l]) >= scenario.threshold) {
+                            mask[l] = true;
+                            break;
+                        }
+                    }
+                }
+
+                rebalance(threshold_rebalancing_cost, months, t);
+            }
+        }
+
+        // Simulate TER
+        if (scenario.fees > 0.0f) {
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t l = 0; l < L; ++l) {
+                    current_values[i][l] *= 1.0f - (scenario.fees / 12.0f);
+                }
+            }
+
+            compute_totals();
+            check_failures(months, t);
+        }
+
+        // Adjust the withdrawals for inflation
+        {
+            const float* inflation = series.inflation + first_period + t;
+
+            for (size_t l = 0; l < L; ++l) {
+                withdrawal[l] *= inflation[l];
+                minimum[l] *= inflation[l];
+                target_value[l] *= inflation[l];
+            }
+        }
+
+        // Monthly withdrawal
+        if ((months - 1) % scenario.withdraw_frequency == 0) {
+            compute_totals();
+
+            auto periods = scenario.withdraw_frequency;
+            if ((months - 1) + scenario.withdraw_frequency > total_months) {
+                periods = total_months - (months - 1);
+            }
+
+            for (size_t l = 0; l < L; ++l) {
+                float withdrawal_amount = 0;
+
+                if (scenario.wmethod == swr::WithdrawalMethod::STANDARD) {
+                    withdrawal_amount = withdrawal[l] / (12.0f / periods);
+                } else {
+                    withdrawal_amount = (total_values[l] * (scenario.wr / 100.0f)) / (12.0f / periods);
+                    withdrawal_amount = std::max(withdrawal_amount, minimum[l] / (12.0f / periods));
+                }
+
+                // Social security means we have less to withdraw
+                if (scenario.social_security) {
+                    if ((months / 12.0f) >= scenario.social_delay) {
+                        withdrawal_amount -= (scenario.social_coverage * withdrawal_amount);
+                        withdrawal_amount -= scenario.social_amount / 12.0f;
+                    }
+                }
+
+                // Extra income (without delay) means we have less to withdraw
+                if (scenario.extra_income) {
+                    withdrawal_amount -= scenario.extra_income_coverage * (scenario.initial_value * (scenario.wr / 100.0f) / (12.0f / periods));
+                    withdrawal_amount -= scenario.extra_income_amount / 12.0f;
+                }
+
+                last_withdrawal_amount[l] = withdrawal_amount;
+            }
+
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t l = 0; l < L; ++l) {
+                    const auto value = current_values[i][l];
+                    if (last_withdrawal_amount[l] > 0.0f) {
+                        current_values[i][l] = std::max(0.0f, value - (value / total_values[l]) * last_withdrawal_amount[l]);
+                    }
+                }
+            }
+
+            // Check for failure after the withdrawal
+            const bool end = months == total_months;
+            for (size_t l = 0; l < L; ++l) {
+                if (last_withdrawal_amount[l] <= 0.0f || failure[l]) {
+                    continue;
+                }
+
+                float value = 0.0f;
+                for (size_t i = 0; i < n; ++i) {
+                    value += current_values[i][l];
+                }
+
+                if (scenario.is_failure(end, target_value[l], value)) {
+                    year_withdrawn[l] += total_values[l];
+
+                    failure[l]                 = true;
+                    outcomes[l].failure_months = months;
+                    outcomes[l].failure_year   = scenario.start_year + (first_period + l + t) / 12;
+                    outcomes[l].failure_eff_wr = year_withdrawn[l] / year_start_value[l];
+                } else {
+                    year_withdrawn[l] += last_withdrawal_amount[l];
+                }
+            }
+        }
+
+        // Record spending
+        if constexpr (S != swr::Statistics::SUCCESS) {
+            for (size_t l = 0; l < L; ++l) {
+                if (!failure[l]) {
+                    if ((months - 1) % 12 == 0) {
+                        outcomes[l].spending.push_back(last_withdrawal_amount[l]);
+                    } else {
+                        outcomes[l].spending.back() += last_withdrawal_amount[l];
+                    }
+                }
+            }
+        }
+
+        // End of the year of the lanes (December or end of the period)
+        for (size_t l = 0; l < L; ++l) {
+            mask[l] = (first_period + l + t) % 12 == 11 || t == total_months - 1;
+
+            if (mask[l]) {
+                total_withdrawn[l] += year_withdrawn[l];
+            }
+        }
+
+        // Yearly Rebalance and check for failure
+        if (n > 1) {
+            if (scenario.rebalance == swr::Rebalancing::YEARLY) {
+                rebalance(yearly_rebalancing_cost, months + 1, t);
+            }
+        }
+    }
+
+    compute_totals();
+
+    for (size_t l = 0; l < L; ++l) {
+        outcomes[l].failure         = failure[l];
+        outcomes[l].final_value     = failure[l] ? 0.0f : total_values[l];
+        outcomes[l].total_withdrawn = total_withdrawn[l];
+
+        record_period<S>(res, outcomes[l]);
+    }
+}
+
+// Cumulative indices of the series, from the start of the simulation
+struct prefix_indices {
+    std::vector<std::vector<double>> growth; // Growth of each asset (with exchange rates) over the first j months
+    std::vector<double>              fees;   // Part of the portfolio left after k months of fees
+};
+
+// Indicates if the scenario can be simulated with the prefix engine
+// Without rebalancing, withdrawing by allocation takes the same fraction of every asset, so the
+// portfolio is always the initial mix grown by the cumulative returns, scaled by a single factor.
+bool prefix_compatible(const swr::scenario& scenario) {
+    return scenario.simulation == swr::Simulation::BACKTESTING && scenario.wmethod == swr::WithdrawalMethod::STANDARD
+           && scenario.wselection == swr::WithdrawalSelection::ALLOCATION && scenario.flexibility == swr::Flexibility::NONE && !scenario.glidepath
+           && scenario.initial_cash == 0.0f && !scenario.social_security && !scenario.extra_income && scenario.final_threshold == 0.0f
+           && (scenario.portfolio.size() == 1 || scenario.rebalance == swr::Rebalancing::NONE);
+}
+
+// Compute the cumulative indices for the given number of months
+// Returns false if the returns are not all positive, in which case the portfolio
+// cannot be expressed from the cumulative growth
+bool prepare_prefix(prefix_indices& indices, const swr::scenario& scenario, size_t months, const series_set& series) {
+    const size_t n = scenario.portfolio.size();
+
+    indices.growth.resize(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        auto& growth = indices.growth[i];
+
+        growth.resize(months + 1);
+        growth[0] = 1.0;
+
+        for (size_t j = 0; j < months; ++j) {
+            const double change = series.returns[i][j];
+
+            if (change <= 0.0) {
+                return false;
+            }
+
+            growth[j + 1] = growth[j] * change;
+        }
+    }
+
+    const double fees = scenario.fees > 0.0f ? 1.0 - (scenario.fees / 12.0f) : 1.0;
+
+    indices.fees.resize(scenario.years * 12 + 1);
+    indices.fees[0] = 1.0;
+
+    for (size_t k = 0; k < scenario.years * 12; ++k) {
+        indices.fees[k + 1] = indices.fees[k] * fees;
+    }
+
+    return true;
+}
+
+// Simulate one period from the cumulative indices
+// The value of the portfolio after k months is factor * fees[k] * G(k) where G(k) is the initial
+// mix grown until month k. Each withdrawal only reduces the factor by amount / (fees[k] * G(k)),
+// so the simulation is a prefix sum over the months, without any per-asset state.
+// The indices are in double precision while the kernels work in float, so only the failure
+// decision and the withdrawn amounts (computed in float, like the kernels) are the ones of
+// the kernels, the terminal value and the effective withdrawal rate of a failure are not.
+// The engine is therefore only used for the success statistics. When a withdrawal comes
+// close to the value of the portfolio, both could decide differently on the failure. In that
+// case, or on a failure when the failures are not recorded, nothing is recorded and false is
+// returned, for the period to be simulated by the kernel.
+template <typename Output>
+bool swr_simulation_prefix(Output& res, const swr::scenario& scenario, const series_set& series, size_t period, const prefix_indices& indices, bool failures) {
+    const size_t n            = scenario.portfolio.size();
+    const size_t total_months = scenario.years * 12;
+
+    period_outcome outcome;
+    outcome.current_year  = scenario.start_year + period / 12;
+    outcome.current_month = 1 + period % 12;
+
+    // The initial mix, relative to the start of the period
+    asset_array<double> weights(n);
+    for (size_t i = 0; i < n; ++i) {
+        weights[i] = scenario.initial_value * (scenario.portfolio[i].allocation / 100.0f) / indices.growth[i][period];
+    }
+
+    // The amount of money withdrawn per year, adjusted for inflation like in the kernels
+    float withdrawal      = scenario.initial_value * (scenario.wr / 100.0f);
+    float year_withdrawn  = 0.0f;
+    float total_withdrawn = 0.0f;
+
+    double factor           = 1.0;
+    double value            = 0.0;
+    double year_start_value = 0.0;
+
+    for (size_t i = 0; i < n; ++i) {
+        value += weights[i] * indices.growth[i][period];
+    }
+
+    // The error of the float kernels grows with the values reached by the portfolio
+    constexpr double tolerance = 1e-3;
+    double           peak      = value;
+
+    for (size_t k = 1; k <= total_months; ++k) {
+        const size_t j = period + k;
+
+        // Start of a calendar year (or of the period)
+        if (k == 1 || (j - 1) % 12 == 0) {
+            year_start_value = value;
+            year_withdrawn   = 0.0f;
+        }
+
+        double mix = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            mix += weights[i] * indices.growth[i][j];
+        }
+
+        value = factor * indices.fees[k] * mix;
+        peak  = std::max(peak, value);
+
+        withdrawal *= series.inflation[j - 1];
+
+        if ((k - 1) % scenario.withdraw_frequency == 0) {
+            auto periods = scenario.withdraw_frequency;
+            if ((k - 1) + scenario.withdraw_frequency > total_months) {
+                periods = total_months - (k - 1);
+            }
+
+            const float amount = withdrawal / (12.0f / periods);
+
+            // Too close to the failure to decide like the kernels
+            if (std::abs(value - amount) <= tolerance * peak) {
+                return false;
+            }
+
+            // Withdrawing everything is a failure
+            if (amount >= value) {
+                if (!failures) {
+                    return false;
+                }
+
+                outcome.failure        = true;
+                outcome.failure_months = k;
+                outcome.failure_year   = scenario.start_year + (j - 1) / 12;
+                outcome.failure_eff_wr = (year_withdrawn + value) / year_start_value;
+                break;
+            }
+
+            factor -= amount / (indices.fees[k] * mix);
+            value = factor * indices.fees[k] * mix;
+
+            year_withdrawn += amount;
+        }
+
+        // End of a calendar year (or of the period)
+        if (j % 12 == 0 || k == total_months) {
+            total_withdrawn += year_withdrawn;
+        }
+    }
+
+    outcome.final_value     = outcome.failure ? 0.0f : value;
+    outcome.total_withdrawn = total_withdrawn;
+
+    record_period<swr::Statistics::SUCCESS>(res, outcome);
+
+    return true;
+}
+
+// Amortized check of the timeout and of the cancellation of a simulation
+// Each thread works on its own copy, the clock is only read every few periods
+// The same copy must be used for all the periods of a thread for the count to be kept
+struct stop_check {
+    swr::cancellation_token*      token    = nullptr;
+    chr::steady_clock::time_point deadline = chr::steady_clock::time_point::max();
+    size_t                        periods  = 0;
+
+    static constexpr size_t interval = 16;
+
+    // Indicates if the simulation must stop, after the given number of periods
+    bool operator()(size_t done = 1) {
+        periods += done;
+
+        if (periods < interval) {
+            return false;
+        }
+
+        periods = 0;
+
+        if (token && token->stop()) {
+            return true;
+        }
+
+        return chr::steady_clock::now() > deadline;
+    }
+};
+
+// One simulation of a batch, the batches vary the withdrawal rate and the allocation
+struct batch_entry {
+    float              wr;
+    std::vector<float> allocations; // Allocation of each asset of the portfolio
+};
+
+// The entry of the scenario as it is configured
+batch_entry scenario_entry(const swr::scenario& scenario) {
+    batch_entry entry{scenario.wr, {}};
+
+    for (auto& position : scenario.portfolio) {
+        entry.allocations.push_back(position.allocation);
+    }
+
+    return entry;
+}
+
+// Configure the scenario for one entry of a batch
+void apply_entry(swr::scenario& scenario, const batch_entry& entry) {
+    scenario.wr = entry.wr;
+
+    for (size_t i = 0; i < entry.allocations.size(); ++i) {
+        scenario.portfolio[i].allocation = entry.allocations[i];
+    }
+}
+
+// Simulate the backtesting periods [first, last) with each entry of the batch
+// Each period starts one month after the previous one. Each period is simulated with
+// all the entries before the next one, the results of batch[e] being recorded in res[e].
+template <swr::Statistics S, typename Output>
+bool swr_backtesting(std::span<Output>            res,
+                     swr::scenario&               scenario,
+                     std::span<const batch_entry> batch,
+                     size_t                       withdraw_index,
+                     size_t                       first,
+                     size_t                       last,
+                     const series_set&            series,
+                     const prefix_indices*        indices,
+                     period_kernel                kernel,
+                     stop_check&                  stop) {
+    size_t period = first;
+
+    // Simulate the periods from the cumulative indices if possible
+    // The failures are left to the kernel, for their effective withdrawal rate
+    if (S == swr::Statistics::SUCCESS && indices) {
+        for (; period < last; ++period) {
+            for (size_t e = 0; e < batch.size(); ++e) {
+                apply_entry(scenario, batch[e]);
+
+                if (!swr_simulation_prefix(res[e], scenario, series, period, *indices, false)) {
+                    auto outcome = kernel(scenario, withdraw_index, series, period, nullptr);
+                    record_period<S>(res[e], outcome);
+                }
+            }
+
+            if (stop(batch.size())) {
+                return false;
+            }
+        }
+    }
+
+    // Simulate the periods by groups of lanes if possible
+    if (lanes_compatible(scenario)) {
+        for (; period + simulation_lanes <= last; period += simulation_lanes) {
+            for (size_t e = 0; e < batch.size(); ++e) {
+                apply_entry(scenario, batch[e]);
+                swr_simulation_lanes<simulation_lanes, S>(res[e], scenario, period, series);
+            }
+
+            if (stop(simulation_lanes * batch.size())) {
+                return false;
+            }
+        }
+    }
+
+    // The remaining periods are simulated one by one
+    for (; period < last; ++period) {
+        for (size_t e = 0; e < batch.size(); ++e) {
+            apply_entry(scenario, batch[e]);
+            auto outcome = kernel(scenario, withdraw_index, series, period, nullptr);
+            record_period<S>(res[e], outcome);
+        }
+
+        if (stop(batch.size())) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Run the bootstrapping simulations [first, last) with each entry of the batch
+// A path is sampled once and simulated with all the entries
+template <swr::Statistics S, typename Output>
+bool swr_bootstrapping(std::span<Output>            res,
+                       swr::scenario&               scenario,
+                       std::span<const batch_entry> batch,
+                       size_t                       withdraw_index,
+                       size_t                       first,
+                       size_t                       last,
+                       const series_set&            series,
+                       period_kernel                kernel,
+                       stop_check&                  stop) {
+    const uint64_t span = scenario.end_year - scenario.start_year + 1;
+
+    // The sampled years of a path, relative to the start year
+    // The data itself is never copied, the kernel reads the sampled years in place
+    std::vector<size_t>   path(scenario.years);
+    std::vector<uint32_t> bits(scenario.years);
+
+    swr::random_paths generator(scenario.seed, scenario.stream);
+
+    for (size_t simulation = first; simulation < last; ++simulation) {
+        // The years of a path only depend on its index, not on the thread simulating it
+        generator.uniforms(bits.data(), bits.size(), simulation);
+
+        for (size_t y = 0; y < path.size(); ++y) {
+            path[y] = (bits[y] * span) >> 32;
+        }
+
+        for (size_t e = 0; e < batch.size(); ++e) {
+            apply_entry(scenario, batch[e]);
+            auto outcome = kernel(scenario, withdraw_index, series, 0, path.data());
+            record_period<S>(res[e], outcome);
+        }
+
+        if (stop(batch.size())) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Run the Monte Carlo simulations [first, last) with each entry of the batch
+// A path is generated once and simulated with all the entries
+template <swr::Statistics S, typename Output>
+bool swr_monte_carlo(std::span<Output>            res,
+                     swr::scenario&               scenario,
+                     std::span<const batch_entry> batch,
+                     size_t                       withdraw_index,
+                     size_t                       first,
+                     size_t                       last,
+                     period_kernel                kernel,
+                     stop_check&                  stop) {
+    const size_t n = scenario.portfolio.size();
+
+    auto mean_data = [&scenario](const auto& data) {
+        float mean = 0.0f;
+        size_t count = 0;
+        for (auto x : data) {
+            if (x.year >= scenario.start_year && x.year <= scenario.end_year) {
+                mean += std::log(x.value);
+                ++count;
+            }
+        }
+        return mean / count;
+    };
+
+    auto stddev_data = [&scenario](const auto& data, float mean) {
+        float std = 0.0f;
+        size_t count = 0;
+        for (auto x : data) {
+            if (x.year >= scenario.start_year && x.year <= scenario.end_year) {
+                std += (std::log(x.value) - mean) * (std::log(x.value) - mean);
+                ++count;
+            }
+        }
+        return std::sqrt(std / count);
+    };
+
+    const auto& market = *scenario.market;
+
+    auto mean_inflation = mean_data(*market.inflation_data);
+    auto stdd_inflation = stddev_data(*market.inflation_data, mean_inflation);
+
+    std::vector<float> mean_returns(n);
+    std::vector<float> stdd_returns(n);
+
+    std::vector<float> mean_exchange_rates(n);
+    std::vector<float> stdd_exchange_rates(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        mean_returns[i] = mean_data(*market.values[i]);
+        stdd_returns[i] = stddev_data(*market.values[i], mean_returns[i]);
+
+        if (market.exchange_set[i]) {
+            mean_exchange_rates[i] = mean_data(*market.exchange_rates[i]);
+            stdd_exchange_rates[i] = stddev_data(*market.exchange_rates[i], mean_exchange_rates[i]);
+        }
+    }
+
+    const size_t months = scenario.years * 12;
+
+    // The series of a path: the inflation, the returns of each asset and the
+    // exchange rates of the assets that have some. They are only as long as
+    // the path and not copies of the data.
+    // The normals are drawn in this layout for the whole path before the exchange
+    // rates are fused into the returns, so the fusion does not change the numbers
+    // drawn for a path (changing the layout would change all the results).
+    const size_t exchanges = std::ranges::count(market.exchange_set, true);
+
+    std::vector<float> path(months * (1 + n + exchanges));
+
+    series_set series;
+    series.inflation = path.data();
+
+    for (size_t i = 0; i < n; ++i) {
+        series.returns.push_back(path.data() + (1 + i) * months);
+    }
+
+    auto scale = [months](float* normals, float mean, float stdd) {
+        for (size_t m = 0; m < months; ++m) {
+            normals[m] = mean + stdd * normals[m];
+        }
+    };
+
+    swr::random_paths generator(scenario.seed, scenario.stream);
+
+    for (size_t simulation = first; simulation < last; ++simulation) {
+        // The normals of a path only depend on its index, not on the thread simulating it
+        generator.normals(path.data(), path.size(), simulation);
+
+        scale(path.data(), mean_inflation, stdd_inflation);
+
+        for (size_t i = 0, e = 0; i < n; ++i) {
+            scale(path.data() + (1 + i) * months, mean_returns[i], stdd_returns[i]);
+
+            if (market.exchange_set[i]) {
+                scale(path.data() + (1 + n + e++) * months, mean_exchange_rates[i], stdd_exchange_rates[i]);
+            }
+        }
+
+        swr::exp_inplace(path.data(), path.size());
+
+        // Fuse the exchange rates into the returns of their assets
+        for (size_t i = 0, e = 0; i < n; ++i) {
+            if (market.exchange_set[i]) {
+                float*       returns   = path.data() + (1 + i) * months;
+                const float* exchanges = path.data() + (1 + n + e++) * months;
+
+                for (size_t m = 0; m < months; ++m) {
+                    returns[m] *= exchanges[m];
+                }
+            }
+        }
+
+        for (size_t e = 0; e < batch.size(); ++e) {
+            apply_entry(scenario, batch[e]);
+            auto outcome = kernel(scenario, withdraw_index, series, 0, nullptr);
+            record_period<S>(res[e], outcome);
+        }
+
+        if (stop(batch.size())) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Merge the distributions accumulated by a thread in the results
+void merge_distributions(swr::results& res, const swr::results& distributions) {
+    res.tv_statistics.merge(distributions.tv_statistics);
+    res.spending_statistics.merge(distributions.spending_statistics);
+
+    res.years_large_spending += distributions.years_large_spending;
+    res.years_small_spending += distributions.years_small_spending;
+    res.years_volatile_up_spending += distributions.years_volatile_up_spending;
+    res.years_volatile_down_spending += distributions.years_volatile_down_spending;
+}
+
+// Split the simulations [0, count) in contiguous chunks simulated by several threads
+// Each thread works on its own copy of the scenario, accumulates the distributions
+// of its periods and keeps their other outcomes. The distributions are then merged
+// and the outcomes recorded in chunk order, so the results, including the tie breaks
+// on the starting periods and the sums, are the ones of a sequential run. The chunks
+// are simulated in waves of one chunk per thread, so that the kept outcomes do not
+// grow with the count. There is one result (and one set of outcomes by chunk) for
+// each entry of the batch. When there are fewer chunks than threads, the entries of
+// a chunk are split between several threads.
+template <swr::Statistics S, typename Simulate>
+bool parallel_simulation(std::span<swr::results>      res,
+                         std::span<const batch_entry> batch,
+                         const swr::scenario&         scenario,
+                         size_t                       threads,
+                         size_t                       count,
+                         size_t                       chunk,
+                         Simulate                     simulate) {
+    // Nothing to split (and no wave to size)
+    if (!count) {
+        return true;
+    }
+
+    const size_t chunks = (count + chunk - 1) / chunk;
+    const size_t wave   = std::min(threads, chunks);
+    const size_t groups = std::clamp<size_t>(threads / wave, 1, batch.size());
+    const size_t group  = (batch.size() + groups - 1) / groups;
+
+    std::vector<std::vector<chunk_outcomes>> outcomes(wave, std::vector<chunk_outcomes>(batch.size()));
+    std::atomic<bool>                        complete = true;
+
+    cpp::default_thread_pool pool(wave * groups);
+
+    for (size_t first_chunk = 0; first_chunk < chunks && complete; first_chunk += wave) {
+        const size_t wave_chunks = std::min(wave, chunks - first_chunk);
+
+        for (size_t c = 0; c < wave_chunks; ++c) {
+            for (size_t first_entry = 0; first_entry < batch.size(); first_entry += group) {
+                pool.do_task(
+                        [&outcomes, &scenario, &complete, &simulate, batch, chunk, count, first_chunk, group](size_t c, size_t first_entry) {
+                            auto my_scenario = scenario;
+
+                            const size_t first = (first_chunk + c) * chunk;
+                            const size_t last  = std::min(count, first + chunk);
+                            const size_t size  = std::min(group, batch.size() - first_entry);
+
+                            std::span<chunk_outcomes> current(outcomes[c].data() + first_entry, size);
+
+                            for (auto& entry_outcomes : current) {
+                                entry_outcomes.outcomes.clear();
+                                entry_outcomes.outcomes.reserve(last - first);
+                                entry_outcomes.distributions = {};
+                            }
+
+                            if (!simulate(current, batch.subspan(first_entry, size), my_scenario, first, last)) {
+                                complete = false;
+                            }
+                        },
+                        c,
+                        first_entry);
+            }
+        }
+
+        pool.wait();
+
+        for (size_t c = 0; c < wave_chunks; ++c) {
+            for (size_t e = 0; e < res.size(); ++e) {
+                merge_distributions(res[e], outcomes[c][e].distributions);
+
+                for (auto& outcome : outcomes[c][e].outcomes) {
+                    record_ordered<S>(res[e], outcome);
+                }
+            }
+        }
+    }
+
+    return complete;
+}
+
+// Simulate the periods [0, count) in a stratified order, for anytime results
+// The periods are simulated by units and the units are visited with a stride coprime
+// with their count, so the periods done before a stop are spread over the whole range.
+// The outcomes are recorded in chronological order, so a complete run gives the same
+// results as the other orders.
+template <swr::Statistics S, typename Simulate>
+bool stratified_simulation(std::span<swr::results>      res,
+                           std::span<const batch_entry> batch,
+                           const swr::scenario&         scenario,
+                           size_t                       threads,
+                           size_t                       count,
+                           size_t                       unit,
+                           const stop_check&            stop,
+                           Simulate                     simulate) {
+    if (!count) {
+        return true;
+    }
+
+    const size_t units = (count + unit - 1) / unit;
+
+    // A stride close to the golden ratio spreads the first units evenly
+    size_t stride = std::max<size_t>(1, static_cast<size_t>(0.618 * units));
+    while (std::gcd(stride, units) != 1) {
+        ++stride;
+    }
+
+    std::vector<std::vector<chunk_outcomes>> outcomes(units, std::vector<chunk_outcomes>(res.size()));
+    std::atomic<size_t>                      next     = 0;
+    std::atomic<bool>                        complete = true;
+
+    auto work = [&]() {
+        auto my_scenario = scenario;
+        auto my_stop     = stop;
+
+        for (size_t k = next++; k < units && complete; k = next++) {
+            const size_t u     = (k * stride) % units;
+            const size_t first = u * unit;
+            const size_t last  = std::min(count, first + unit);
+
+            if (!simulate(std::span(outcomes[u]), batch, my_scenario, first, last, my_stop)) {
+                complete = false;
+            }
+        }
+    };
+
+    threads = std::clamp<size_t>(threads, 1, units);
+
+    if (threads > 1) {
+        cpp::default_thread_pool pool(threads);
+
+        for (size_t t = 0; t < threads; ++t) {
+            pool.do_task(work);
+        }
+
+        pool.wait();
+    } else {
+        work();
+    }
+
+    for (auto& unit_outcomes : outcomes) {
+        for (size_t e = 0; e < res.size(); ++e) {
+            merge_distributions(res[e], unit_outcomes[e].distributions);
+
+            for (auto& outcome : unit_outcomes[e].outcomes) {
+                record_ordered<S>(res[e], outcome);
+            }
+        }
+    }
+
+    return complete;
+}
+
+} // end of anonymous namespace
+
+struct swr::plan_state {
+    series_set     series;             // The series of the scenario, from its start year
+    period_kernel  kernel;             // The scalar kernel, selected once for all the periods
+    size_t         withdraw_index = 0; // The asset to withdraw from (withdrawal selection)
+    bool           prefix         = false; // Indicates if the cumulative indices can be used
+    prefix_indices indices;            // The cumulative indices of the backtesting periods
+};
+
+namespace {
+
+// Simulate the scenario with each entry of the batch, the results of batch[e] going in res[e]
+// The series, the kernel and the cumulative indices do not depend on the withdrawal rate nor
+// on the allocation and are prepared once in the plan, the data of each period or path is
+// then shared by all the entries
+template <swr::Statistics S>
+void swr_simulation_inside(std::span<swr::results> res, swr::scenario& scenario, std::span<const batch_entry> batch, const swr::plan_state& state) {
+    auto start_tp = chr::high_resolution_clock::now();
+
+    const auto& series         = state.series;
+    const auto  kernel         = state.kernel;
+    const auto  withdraw_index = state.withdraw_index;
+
+    // Every thread of every mode observes the timeout and the cancellation
+    stop_check stop;
+    stop.token = scenario.cancellation.get();
+
+    if (scenario.timeout_msecs) {
+        stop.deadline = chr::steady_clock::now() + chr::milliseconds(scenario.timeout_msecs);
+    }
+
+    // Run the simulations [0, count) either sequentially or on several threads
+    // The threads left over by the periods split the entries of the batch
+    auto run = [res, batch, &scenario](size_t count, size_t granularity, auto simulate) {
+        const size_t chunks = std::min(scenario.threads, (count + granularity - 1) / granularity);
+
+        if (scenario.threads > 1 && count) {
+            const size_t chunk = granularity * ((count + chunks * granularity - 1) / (chunks * granularity));
+            return parallel_simulation<S>(res, batch, scenario, scenario.threads, count, chunk, simulate);
+        }
+
+        return simulate(res, batch, scenario, 0, count);
+    };
+
+    auto reserve = [res](size_t count) {
+        if constexpr (S == swr::Statistics::FULL) {
+            for (auto& entry_res : res) {
+                entry_res.terminal_values.reserve(count);
+            }
+        }
+    };
+
+    // The random paths only depend on their index, but the sketches of the distributions
+    // depend on how they are merged. The random simulations are therefore always merged by
+    // chunks of the same size, for the results not to depend on the number of threads.
+    auto run_random = [res, batch, &scenario](size_t count, auto simulate) {
+        const size_t chunk = 4096;
+
+        if (scenario.threads > 1) {
+            return parallel_simulation<S>(res, batch, scenario, scenario.threads, count, chunk, simulate);
+        }
+
+        // On the calling thread, the chunks are merged one after the other, like the waves of the threads
+        std::vector<chunk_outcomes> outcomes(batch.size());
+
+        for (size_t first = 0; first < count; first += chunk) {
+            const size_t last = std::min(count, first + chunk);
+
+            for (auto& entry_outcomes : outcomes) {
+                entry_outcomes.outcomes.clear();
+                entry_outcomes.distributions = {};
+            }
+
+            const bool complete = simulate(std::span(outcomes), batch, scenario, first, last);
+
+            for (size_t e = 0; e < res.size(); ++e) {
+                merge_distributions(res[e], outcomes[e].distributions);
+
+                for (auto& outcome : outcomes[e].outcomes) {
+                    record_ordered<S>(res[e], outcome);
+                }
+            }
+
+            if (!complete) {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    // 3. Do the actual simulation
+
+    bool   complete = true;
+    size_t total    = 0;
+
+    if (scenario.simulation == swr::Simulation::BACKTESTING) {
+        reserve(((scenario.end_year - scenario.start_year) - scenario.years) * 12);
+
+        const size_t periods = (scenario.end_year - scenario.years - scenario.start_year + 1) * 12;
+
+        const prefix_indices* prefix = state.prefix ? &state.indices : nullptr;
+
+        total = periods;
+
+        auto backtest = [&](auto out, auto my_batch, swr::scenario& my_scenario, size_t first, size_t last, stop_check& my_stop) {
+            return swr_backtesting<S>(out, my_scenario, my_batch, withdraw_index, first, last, series, prefix, kernel, my_stop);
+        };
+
+        if (scenario.anytime) {
+            complete = stratified_simulation<S>(res, batch, scenario, scenario.threads, periods, simulation_lanes, stop, backtest);
+        } else {
+            complete = run(periods, 4 * simulation_lanes, [&](auto out, auto my_batch, swr::scenario& my_scenario, size_t first, size_t last) {
+                auto my_stop = stop;
+                return backtest(out, my_batch, my_scenario, first, last, my_stop);
+            });
+        }
+    } else if (scenario.simulation == swr::Simulation::BOOTSTRAPPING) {
+        reserve(scenario.simulations);
+
+        total = scenario.simulations;
+
+        complete = run_random(scenario.simulations, [&](auto out, auto my_batch, swr::scenario& my_scenario, size_t first, size_t last) {
+            auto my_stop = stop;
+            return swr_bootstrapping<S>(out, my_scenario, my_batch, withdraw_index, first, last, series, kernel, my_stop);
+        });
+    } else if (scenario.simulation == swr::Simulation::MONTE_CARLO) {
+        reserve(scenario.simulations);
+
+        total = scenario.simulations;
+
+        complete = run_random(scenario.simulations, [&](auto out, auto my_batch, swr::scenario& my_scenario, size_t first, size_t last) {
+            auto my_stop = stop;
+            return swr_monte_carlo<S>(out, my_scenario, my_batch, withdraw_index, first, last, kernel, my_stop);
+        });
+    } else {
+        for (auto& entry_res : res) {
+            entry_res.error   = true;
+            entry_res.message = "Invalid simulation method";
+        }
+        return;
+    }
+
+    if (!complete) {
+        auto stop_tp  = chr::high_resolution_clock::now();
+        auto duration = chr::duration_cast<chr::milliseconds>(stop_tp - start_tp).count();
+
+        const bool cancelled = scenario.cancellation && scenario.cancellation->cancelled;
+
+        // In anytime mode, the simulations done before the timeout still give results
+        // The entries of a batch are simulated together, so they all stop at the same point
+        if (scenario.anytime && !cancelled && res[0].successes + res[0].failures) {
+            for (auto& entry_res : res) {
+                entry_res.partial = true;
+                entry_res.message += std::format("The results are partial, the computation was stopped after {}ms. ", duration);
+            }
+        } else {
+            for (auto& entry_res : res) {
+                entry_res.error   = true;
+                entry_res.message = cancelled ? "The computation was cancelled" : "The computation took too long";
+            }
+
+            if (cancelled) {
+                std::cout << "ERROR: Cancelled after " << duration << "ms\n";
+            } else {
+                std::cout << "ERROR: Timeout after " << duration << "ms\n";
+            }
+
+            return;
+        }
+    }
+
+    for (auto& entry_res : res) {
+        entry_res.withdrawn_per_year = (entry_res.total_withdrawn / scenario.years) / static_cast<float>(entry_res.successes);
+
+        entry_res.highest_eff_wr *= 100.0f;
+        entry_res.lowest_eff_wr *= 100.0f;
+
+        entry_res.success_rate = 100 * (entry_res.successes / static_cast<float>(entry_res.successes + entry_res.failures));
+        entry_res.completed    = (entry_res.successes + entry_res.failures) / static_cast<float>(total);
+
+        entry_res.compute_success_interval();
+        entry_res.compute_terminal_values();
+        entry_res.compute_spending(scenario.years);
+
+        simulations += entry_res.successes + entry_res.failures;
+    }
+}
+
+// Validate the parts of the scenario that depend on the allocation of the portfolio
+// On error, the message is set in the results and false is returned
+bool allocation_validation(swr::results& res, const swr::scenario& scenario) {
+    if (scenario.glidepath) {
+        auto& portfolio = scenario.portfolio;
+
+        if (scenario.gp_pass > 0.0f && scenario.gp_goal <= portfolio[0].allocation) {
+            res.message = std::format("Invalid goal/pass ({}/{}) (1) for glidepath", scenario.gp_goal, scenario.gp_pass);
+            res.error   = true;
+            return false;
+        }
+
+        if (scenario.gp_pass < 0.0f && scenario.gp_goal >= portfolio[0].allocation) {
+            res.message = std::format("Invalid goal/pass ({}/{}) (2) for glidepath", scenario.gp_goal, scenario.gp_pass);
+            res.error   = true;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Validate the scenario and adapt its period to the available data
+// The allocation of the portfolio is validated separately (allocation_validation)
+// On error, the message is set in the results and false is returned
+bool swr_validation(swr::results& res, swr::scenario& scenario, size_t& withdraw_index) {
+    const size_t n = scenario.portfolio.size();
+
+    // The portfolio is checked first, the market data is indexed by its assets
+    if (!n) {
+        res.message = "Cannot work with an empty portfolio";
+        res.error   = true;
+        return false;
+    }
+
+    if (!scenario.market) {
+        res.message = "Invalid scenario (no market data)";
+        res.error   = true;
+        return false;
+    }
+
+    const auto& market = *scenario.market;
+
+    if (market.values.size() != n || std::ranges::any_of(market.values, [](const auto& v) { return !v; }) || !market.inflation_data) {
+        res.message = "Invalid scenario (the market data does not match the portfolio)";
+        res.error   = true;
+        return false;
+    }
+
+    if (market.exchange_set.size() != n || market.exchange_rates.size() != n) {
+        res.message = "Invalid scenario (no exchange rates)";
+        res.error   = true;
+        return false;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        if (market.exchange_set[i] && !market.exchange_rates[i]) {
+            res.message = "Invalid scenario (no exchange rates)";
+            res.error   = true;
+            return false;
+        }
+    }
+
+    auto& inflation_data = *market.inflation_data;
+    auto& values         = market.values;
+    auto& exchange_set   = market.exchange_set;
+    auto& exchange_rates = market.exchange_rates;
+
+    // 0. Make sure the years make some sense
+
+    if (scenario.start_year >= scenario.end_year) {
+        res.message = "The end year must be higher than the start year";
+        res.error   = true;
+        return false;
+    }
+
+    if (!scenario.years) {
+        res.message = "The number of years must be at least 1";
+        res.error   = true;
+        return false;
+    }
+
+    // 1. Adapt the start and end year with inflation and stocks
+    // Note: the data is already normalized so we do not have to check for stat
     // and end months
 
     bool changed = false;
@@ -841,14 +2072,14 @@ swr::results swr_simulation(swr::scenario& scenario) {
         if (!valid_year(inflation_data, scenario.start_year) && !valid_year(inflation_data, scenario.end_year)) {
             res.message = "The given period is out of the historical data, it's either too far in the future or too far in the past";
             res.error   = true;
-            return res;
+            return false;
         }
 
         for (auto& v : values) {
-            if (!valid_year(v, scenario.start_year) && !valid_year(v, scenario.end_year)) {
+            if (!valid_year(*v, scenario.start_year) && !valid_year(*v, scenario.end_year)) {
                 res.message = "The given period is out of the historical data, it's either too far in the future or too far in the past";
                 res.error   = true;
-                return res;
+                return false;
             }
         }
     }
@@ -866,20 +2097,20 @@ swr::results swr_simulation(swr::scenario& scenario) {
     }
 
     for (auto& v : values) {
-        if (v.front().year > scenario.start_year) {
-            scenario.start_year = v.front().year;
+        if (v->front().year > scenario.start_year) {
+            scenario.start_year = v->front().year;
             changed             = true;
         }
 
-        if (v.back().year < scenario.end_year) {
-            scenario.end_year = v.back().year;
+        if (v->back().year < scenario.end_year) {
+            scenario.end_year = v->back().year;
             changed           = true;
         }
     }
 
-    for (size_t i = 0; i < N; ++i) {
-        if (scenario.exchange_set[i]) {
-            auto& v = exchange_rates[i];
+    for (size_t i = 0; i < n; ++i) {
+        if (exchange_set[i]) {
+            auto& v = *exchange_rates[i];
 
             if (v.front().year > scenario.start_year) {
                 scenario.start_year = v.front().year;
@@ -898,7 +2129,7 @@ swr::results swr_simulation(swr::scenario& scenario) {
         if (scenario.end_year == scenario.start_year) {
             res.message = "The period is invalid with this duration. Try to use a longer period (1871-2018 works well) or a shorter duration.";
             res.error   = true;
-            return res;
+            return false;
         }
 
         std::stringstream ss;
@@ -908,50 +2139,43 @@ swr::results swr_simulation(swr::scenario& scenario) {
 
     // 2. Make sure the simulation makes sense
 
-    if (scenario.portfolio.empty()) {
-        res.message = "Cannot work with an empty portfolio";
-        res.error   = true;
-        return res;
-    }
-
     if (scenario.wmethod == swr::WithdrawalMethod::VANGUARD && scenario.withdraw_frequency != 1) {
         res.message = "Vanguard dynamic spending is only implemented with monthly withdrawals";
         res.error   = true;
-        return res;
+        return false;
     }
 
     if (scenario.wmethod == swr::WithdrawalMethod::DIE_WITH_ZERO && scenario.withdraw_frequency != 1) {
         res.message = "Die with zero is only implemented with monthly withdrawals";
         res.error   = true;
-        return res;
+        return false;
     }
 
     if (scenario.wmethod == swr::WithdrawalMethod::VPW && scenario.withdraw_frequency != 1) {
         res.message = "VPW is only implemented with monthly withdrawals";
         res.error   = true;
-        return res;
+        return false;
     }
 
-    size_t withdraw_index = 0;
     if (scenario.wselection != swr::WithdrawalSelection::ALLOCATION) {
         auto& portfolio = scenario.portfolio;
 
         if (portfolio.size() != 2) {
             res.message = "This withdrawal selection method only works with two assets";
             res.error   = true;
-            return res;
+            return false;
         }
 
         if (portfolio[0].asset != "us_stocks" && portfolio[0].asset != "us_bonds") {
             res.message = "This withdrawal selection method only works with bonds and stocks";
             res.error   = true;
-            return res;
+            return false;
         }
 
         if (portfolio[1].asset != "us_stocks" && portfolio[1].asset != "us_bonds") {
             res.message = "This withdrawal selection method only works with bonds and stocks";
             res.error   = true;
-            return res;
+            return false;
         }
 
         if (scenario.wselection == swr::WithdrawalSelection::BONDS) {
@@ -975,31 +2199,19 @@ swr::results swr_simulation(swr::scenario& scenario) {
         if (portfolio[0].asset != "us_stocks") {
             res.message = "The first assert must be us_stocks for glidepath";
             res.error   = true;
-            return res;
+            return false;
         }
 
         if (scenario.rebalance != swr::Rebalancing::NONE && scenario.rebalance != swr::Rebalancing::MONTHLY) {
             res.message = "Invalid rebalancing method for glidepath";
             res.error   = true;
-            return res;
+            return false;
         }
 
         if (scenario.gp_pass == 0.0f) {
             res.message = std::format("Invalid pass ({}) for glidepath", scenario.gp_pass);
             res.error   = true;
-            return res;
-        }
-
-        if (scenario.gp_pass > 0.0f && scenario.gp_goal <= portfolio[0].allocation) {
-            res.message = std::format("Invalid goal/pass ({}/{}) (1) for glidepath", scenario.gp_goal, scenario.gp_pass);
-            res.error   = true;
-            return res;
-        }
-
-        if (scenario.gp_pass < 0.0f && scenario.gp_goal >= portfolio[0].allocation) {
-            res.message = std::format("Invalid goal/pass ({}/{}) (2) for glidepath", scenario.gp_goal, scenario.gp_pass);
-            res.error   = true;
-            return res;
+            return false;
         }
     }
 
@@ -1007,28 +2219,31 @@ swr::results swr_simulation(swr::scenario& scenario) {
         if (scenario.wmethod != swr::WithdrawalMethod::STANDARD) {
             res.message = "Invalid withdrawal method for flexibility";
             res.error   = true;
-            return res;
+            return false;
         }
 
         if (scenario.initial_cash > 0.0f) {
             res.message = "Cannot use cash with flexibility";
             res.error   = true;
-            return res;
+            return false;
         }
 
         if (scenario.flexibility_threshold_1 <= scenario.flexibility_threshold_2) {
             res.message = "The first threshold must be higher than the second";
             res.error   = true;
-            return res;
+            return false;
         }
     }
 
     // More validation of data (should not happen but would fail silently otherwise)
 
     bool valid = true;
-    for (size_t i = 0; i < N; ++i) {
-        valid &= swr::is_start_valid(values[i], scenario.start_year, 1);
-        valid &= swr::is_start_valid(exchange_rates[i], scenario.start_year, 1);
+    for (size_t i = 0; i < n; ++i) {
+        valid &= swr::is_start_valid(*values[i], scenario.start_year, 1);
+
+        if (exchange_set[i]) {
+            valid &= swr::is_start_valid(*exchange_rates[i], scenario.start_year, 1);
+        }
     }
 
     valid &= swr::is_start_valid(inflation_data, scenario.start_year, 1);
@@ -1036,10 +2251,170 @@ swr::results swr_simulation(swr::scenario& scenario) {
     if (!valid) {
         res.message = "Invalid data points (internal bug, contact the developer)";
         res.error   = true;
+        return false;
+    }
+
+    return true;
+}
+
+// Prepare the scenario once for all its simulations
+// The period adapted by the validation is set in the copy of the plan, the scenario
+// of the caller is not modified
+swr::simulation_plan swr_prepare(const swr::scenario& scenario) {
+    swr::simulation_plan plan;
+
+    // The market data is shared, the copy only holds the parameters
+    plan.resolved = scenario;
+
+    // Most of the validation does not depend on the withdrawal rate nor on the allocation
+    size_t withdraw_index = 0;
+    if (!swr_validation(plan.validation, plan.resolved, withdraw_index)) {
+        return plan;
+    }
+
+    const auto& resolved = plan.resolved;
+
+    auto state = std::make_shared<swr::plan_state>();
+
+    // Prepare the starting points (for efficiency)
+    state->series = scenario_series(resolved);
+
+    if (resolved.statistics == swr::Statistics::SUCCESS) {
+        state->kernel = select_kernel<false>(resolved);
+    } else {
+        state->kernel = select_kernel<true>(resolved);
+    }
+
+    state->withdraw_index = withdraw_index;
+
+    // The cumulative indices are computed once for all the periods
+    if (resolved.simulation == swr::Simulation::BACKTESTING && prefix_compatible(resolved)) {
+        const size_t periods = (resolved.end_year - resolved.years - resolved.start_year + 1) * 12;
+
+        state->prefix = prepare_prefix(state->indices, resolved, periods - 1 + resolved.years * 12, state->series);
+    }
+
+    plan.state = std::move(state);
+
+    return plan;
+}
+
+// Simulate the plan with each entry of the batch
+// The entries are set in a private copy of the scenario, the plan is not modified
+std::vector<swr::results> swr_simulation(const swr::simulation_plan& plan, std::span<const batch_entry> batch) {
+    if (batch.empty()) {
+        return {};
+    }
+
+    // The final results, one for each entry, with the messages of the validation
+    std::vector<swr::results> res(batch.size(), plan.validation);
+
+    if (!plan.state) {
         return res;
     }
 
-    return swr_simulation_inside<N>(res, scenario, withdraw_index);
+    swr::scenario scenario = plan.resolved;
+
+    // Only the valid entries are simulated
+    std::vector<batch_entry> valid_batch;
+    std::vector<size_t>      valid_entries;
+
+    for (size_t e = 0; e < batch.size(); ++e) {
+        apply_entry(scenario, batch[e]);
+
+        if (allocation_validation(res[e], scenario)) {
+            valid_batch.push_back(batch[e]);
+            valid_entries.push_back(e);
+        }
+    }
+
+    std::vector<swr::results> valid_res(valid_batch.size(), plan.validation);
+
+    if (!valid_batch.empty()) {
+        // Only compute the requested statistics
+        switch (scenario.statistics) {
+        case swr::Statistics::SUCCESS:
+            swr_simulation_inside<swr::Statistics::SUCCESS>(valid_res, scenario, valid_batch, *plan.state);
+            break;
+        case swr::Statistics::SUMMARY:
+            swr_simulation_inside<swr::Statistics::SUMMARY>(valid_res, scenario, valid_batch, *plan.state);
+            break;
+        case swr::Statistics::FULL:
+            swr_simulation_inside<swr::Statistics::FULL>(valid_res, scenario, valid_batch, *plan.state);
+            break;
+        }
+    }
+
+    for (size_t v = 0; v < valid_entries.size(); ++v) {
+        res[valid_entries[v]] = std::move(valid_res[v]);
+    }
+
+    return res;
+}
+
+swr::critical_rates swr_critical_rates(const swr::simulation_plan& plan, std::vector<float> grid) {
+    swr::critical_rates rates;
+    rates.grid = std::move(grid);
+
+    swr::results res = plan.validation;
+
+    if (!plan.state || !allocation_validation(res, plan.resolved)) {
+        rates.message = res.message;
+        rates.error   = true;
+        return rates;
+    }
+
+    // The rate is set in a copy, like in the simulation
+    swr::scenario scenario = plan.resolved;
+
+    const auto& state  = *plan.state;
+    const auto& series = state.series;
+
+    const size_t periods = (scenario.end_year - scenario.years - scenario.start_year + 1) * 12;
+
+    // The spending is not needed, the kernel of the plan may record it
+    const auto kernel = select_kernel<false>(scenario);
+
+    // Use the same engine as the simulation for the results to be the same
+    const bool   prefix         = state.prefix;
+    const auto&  indices        = state.indices;
+    const size_t withdraw_index = state.withdraw_index;
+
+    // Indicates if the given period succeeds with the given rate of the grid
+    auto success = [&](size_t period, size_t g) {
+        scenario.wr = rates.grid[g];
+
+        period_outcome outcome;
+
+        if (!prefix || !swr_simulation_prefix(outcome, scenario, series, period, indices, true)) {
+            outcome = kernel(scenario, withdraw_index, series, period, nullptr);
+        }
+
+        return !outcome.failure;
+    };
+
+    rates.periods.resize(periods);
+
+    // The success of a period is monotone in the withdrawal rate, so we can
+    // search the first (highest) rate of the grid with which it succeeds
+    for (size_t period = 0; period < periods; ++period) {
+        size_t first = 0;
+        size_t last  = rates.grid.size();
+
+        while (first < last) {
+            const size_t middle = first + (last - first) / 2;
+
+            if (success(period, middle)) {
+                last = middle;
+            } else {
+                first = middle + 1;
+            }
+        }
+
+        rates.periods[period] = first;
+    }
+
+    return rates;
 }
 
 } // end of anonymous namespace
@@ -1102,45 +2477,135 @@ std::ostream& swr::operator<<(std::ostream& out, const WithdrawalSelection& wsel
     return out << "Unknown withdrawal method";
 }
 
-swr::results swr::simulation(scenario& scenario) {
-    const size_t number_of_assets = scenario.portfolio.size();
-
-    switch (number_of_assets) {
-    case 1:
-        return swr_simulation<1>(scenario);
-    case 2:
-        return swr_simulation<2>(scenario);
-    case 3:
-        return swr_simulation<3>(scenario);
-    case 4:
-        return swr_simulation<4>(scenario);
-    case 5:
-        return swr_simulation<5>(scenario);
-    case 6:
-        return swr_simulation<6>(scenario);
-    case 7:
-        return swr_simulation<7>(scenario);
-    case 8:
-        return swr_simulation<8>(scenario);
-    default:
-        swr::results res;
-        res.message = "The number of assets is too high";
-        res.error   = true;
-        return res;
+swr::simulation_plan swr::prepare(const scenario& scenario) {
+    return swr_prepare(scenario);
+}
+
+swr::results swr::simulation(const simulation_plan& plan) {
+    const batch_entry entry = scenario_entry(plan.resolved);
+    return std::move(swr_simulation(plan, {&entry, 1}).front());
+}
+
+swr::results swr::simulation(const simulation_plan& plan, float wr) {
+    batch_entry entry = scenario_entry(plan.resolved);
+    entry.wr          = wr;
+    return std::move(swr_simulation(plan, {&entry, 1}).front());
+}
+
+std::vector<swr::results> swr::simulation(const simulation_plan& plan, const std::vector<float>& rates) {
+    std::vector<batch_entry> batch;
+
+    for (float wr : rates) {
+        batch.push_back(scenario_entry(plan.resolved));
+        batch.back().wr = wr;
+    }
+
+    return swr_simulation(plan, batch);
+}
+
+std::vector<swr::results> swr::simulation(const simulation_plan& plan, const std::vector<std::vector<float>>& allocations, const std::vector<float>& rates) {
+    for (auto& allocation : allocations) {
+        if (allocation.size() != plan.resolved.portfolio.size()) {
+            swr::results res;
+            res.message = "The allocations do not match the portfolio";
+            res.error   = true;
+            return std::vector<swr::results>(allocations.size() * rates.size(), res);
+        }
+    }
+
+    std::vector<batch_entry> batch;
+
+    for (auto& allocation : allocations) {
+        for (float wr : rates) {
+            batch.push_back({wr, allocation});
+        }
+    }
+
+    return swr_simulation(plan, batch);
+}
+
+swr::results swr::simulation(const scenario& scenario) {
+    return simulation(prepare(scenario));
+}
+
+std::vector<swr::results> swr::simulation(const scenario& scenario, const std::vector<float>& rates) {
+    return simulation(prepare(scenario), rates);
+}
+
+std::vector<swr::results> swr::simulation(const scenario& scenario, const std::vector<std::vector<float>>& allocations, const std::vector<float>& rates) {
+    return simulation(prepare(scenario), allocations, rates);
+}
+
+std::vector<swr::results> swr::simulation(const scenario& scenario, const std::vector<std::vector<float>>& allocations) {
+    return simulation(scenario, allocations, {scenario.wr});
+}
+
+bool swr::critical_rates_supported(const scenario& scenario) {
+    return scenario.simulation == Simulation::BACKTESTING && scenario.wmethod == WithdrawalMethod::STANDARD && scenario.flexibility == Flexibility::NONE
+           && scenario.initial_cash == 0.0f;
+}
+
+swr::critical_rates swr::critical_withdrawal_rates(const simulation_plan& plan, float start_wr, float end_wr, float step) {
+    // The grid is the same as the one of a scan from start_wr down to end_wr
+    std::vector<float> grid;
+    for (float wr = start_wr; wr >= end_wr; wr -= step) {
+        grid.push_back(wr);
+    }
+
+    return swr_critical_rates(plan, std::move(grid));
+}
+
+swr::critical_rates swr::critical_withdrawal_rates(const scenario& scenario, float start_wr, float end_wr, float step) {
+    return critical_withdrawal_rates(prepare(scenario), start_wr, end_wr, step);
+}
+
+size_t swr::critical_rates::failsafe(float goal) const {
+    // Number of periods by highest successful rate
+    std::vector<size_t> counts(grid.size() + 1, 0);
+    for (auto index : periods) {
+        ++counts[index];
+    }
+
+    // Compute the success rate exactly like the simulation does
+    size_t successes = 0;
+    for (size_t g = 0; g < grid.size(); ++g) {
+        successes += counts[g];
+
+        const float success_rate = 100 * (successes / static_cast<float>(periods.size()));
+        if (success_rate >= 100.0f - goal) {
+            return g;
+        }
+    }
+
+    return grid.size();
+}
+
+void swr::results::compute_terminal_values() {
+    if (!tv_statistics.count) {
+        return;
     }
+
+    tv_median  = tv_statistics.sketch.at((tv_statistics.count / 2) + 1);
+    tv_minimum = tv_statistics.minimum;
+    tv_maximum = tv_statistics.maximum;
+    tv_average = tv_statistics.mean();
 }
 
-void swr::results::compute_terminal_values(std::vector<float> terminal_values) {
-    std::ranges::sort(terminal_values);
+// Wilson score interval of the success rate, at 95%
+void swr::results::compute_success_interval() {
+    const float n = static_cast<float>(successes + failures);
+    const float p = successes / n;
+    const float z = 1.96f;
+
+    const float center = (p + z * z / (2.0f * n)) / (1.0f + z * z / n);
+    const float margin = (z / (1.0f + z * z / n)) * std::sqrt(p * (1.0f - p) / n + z * z / (4.0f * n * n));
 
-    tv_median  = terminal_values[(terminal_values.size() / 2) + 1];
-    tv_minimum = terminal_values.front();
-    tv_maximum = terminal_values.back();
-    tv_average = std::accumulate(terminal_values.begin(), terminal_values.end(), 0.0f) / terminal_values.size();
+    success_lower = 100.0f * std::max(0.0f, center - margin);
+    success_upper = 100.0f * std::min(1.0f, center + margin);
 }
 
-void swr::results::compute_spending(std::vector<std::vector<float>>& yearly_spending, size_t years) {
-    if (yearly_spending.empty()) {
+void swr::results::compute_spending(size_t years) {
+    if (!spending_statistics.count) {
         spending_median  = 0;
         spending_minimum = 0;
         spending_maximum = 0;
@@ -1148,36 +2613,27 @@ void swr::results::compute_spending(std::vector<std::vector<float>>& yearly_spen
         return;
     }
 
-    std::vector<float> spending;
-
-    for (auto& yearly : yearly_spending) {
-        spending.push_back(std::accumulate(yearly.begin(), yearly.end(), 0.0f));
-
-        for (size_t y = 1; y < yearly.size(); ++y) {
-            if (yearly[y] >= 1.5f * yearly[0]) {
-                ++years_large_spending;
-            }
-
-            if (yearly[y] <= 0.5f * yearly[0]) {
-                ++years_small_spending;
-            }
+    spending_median  = spending_statistics.sketch.at((spending_statistics.count / 2) + 1) / years;
+    spending_minimum = spending_statistics.minimum / years;
+    spending_maximum = spending_statistics.maximum / years;
+    spending_average = spending_statistics.mean() / years;
+}
 
-            if (yearly[y] >= 1.1f * yearly[y - 1]) {
-                ++years_volatile_up_spending;
-            }
+bool swr::cancellation_token::stop() {
+    if (cancelled) {
+        return true;
+    }
 
-            if (yearly[y] <= 0.9f * yearly[y - 1]) {
-                ++years_volatile_down_spending;
-            }
+    // The other threads do not wait for the condition to be polled
+    if (condition && lock.try_lock()) {
+        if (condition()) {
+            cancelled = true;
         }
-    }
 
-    std::ranges::sort(spending);
+        lock.unlock();
+    }
 
-    spending_median  = spending[(spending.size() / 2) + 1] / years;
-    spending_minimum = spending.front() / years;
-    spending_maximum = spending.back() / years;
-    spending_average = (std::accumulate(spending.begin(), spending.end(), 0.0f) / spending.size()) / years;
+    return cancelled;
 }
 
 size_t swr::simulations_ran() {
@@ -1186,8 +2642,8 @@ size_t swr::simulations_ran() {
 
 std::ostream& swr::operator<<(std::ostream& out, const scenario& scenario) {
     out << "{"
-        << "portfolio=" << scenario.portfolio << " inflation=" << scenario.inflation_data.name
-        << " exchange_set=" << std::ranges::count(scenario.exchange_set, true) << " wr=" << scenario.wr << " rebalance={" << scenario.rebalance << ","
+        << "portfolio=" << scenario.portfolio << " inflation=" << (scenario.market && scenario.market->inflation_data ? scenario.market->inflation_data->name : "")
+        << " exchange_set=" << (scenario.market ? std::ranges::count(scenario.market->exchange_set, true) : 0) << " wr=" << scenario.wr << " rebalance={" << scenario.rebalance << ","
         << scenario.threshold << "}"
         << " init=" << scenario.initial_value << " years={" << scenario.years << "," << scenario.start_year << "," << scenario.end_year << "}"
         << " withdraw={" << scenario.withdraw_frequency << "," << scenario.wmethod << "," << scenario.wselection << "," << scenario.minimum << "}"
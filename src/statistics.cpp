@@ -0,0 +1,111 @@
+//=======================================================================
+// Copyright Baptiste Wicht 2019-2024.
+// Distributed under the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#include <utility>
+
+#include "statistics.hpp"
+
+void swr::quantile_sketch::compact(size_t h) {
+    if (levels.size() == h + 1) {
+        levels.emplace_back();
+        compactions.push_back(0);
+    }
+
+    auto& level = levels[h];
+    auto& next  = levels[h + 1];
+
+    std::ranges::sort(level);
+
+    // Alternate between the odd and the even values to avoid a bias
+    const size_t pairs  = level.size() / 2;
+    const size_t offset = compactions[h]++ % 2;
+
+    for (size_t i = 0; i < pairs; ++i) {
+        next.push_back(level[2 * i + offset]);
+    }
+
+    // With an odd number of values, the largest one stays at this level
+    level.erase(level.begin(), level.begin() + 2 * pairs);
+
+    if (next.size() > 2 * capacity) {
+        compact(h + 1);
+    }
+}
+
+void swr::quantile_sketch::merge(const quantile_sketch& rhs) {
+    while (levels.size() < rhs.levels.size()) {
+        levels.emplace_back();
+        compactions.push_back(0);
+    }
+
+    for (size_t h = 0; h < rhs.levels.size(); ++h) {
+        levels[h].insert(levels[h].end(), rhs.levels[h].begin(), rhs.levels[h].end());
+    }
+
+    count += rhs.count;
+
+    // The compaction of a level may fill the next one
+    for (size_t h = 0; h < levels.size(); ++h) {
+        if (levels[h].size() > 2 * capacity) {
+            compact(h);
+        }
+    }
+}
+
+float swr::quantile_sketch::at(size_t rank) const {
+    size_t stored = 0;
+    for (auto& level : levels) {
+        stored += level.size();
+    }
+
+    std::vector<std::pair<float, size_t>> weighted;
+    weighted.reserve(stored);
+
+    for (size_t h = 0; h < levels.size(); ++h) {
+        for (auto value : levels[h]) {
+            weighted.emplace_back(value, size_t(1) << h);
+        }
+    }
+
+    if (weighted.empty()) {
+        return 0.0f;
+    }
+
+    std::ranges::sort(weighted);
+
+    size_t cumulated = 0;
+    for (auto& [value, weight] : weighted) {
+        cumulated += weight;
+
+        if (cumulated > rank) {
+            return value;
+        }
+    }
+
+    return weighted.back().first;
+}
+
+float swr::quantile_sketch::quantile(float q) const {
+    if (!count) {
+        return 0.0f;
+    }
+
+    return at(std::min(count - 1, static_cast<size_t>(q * count)));
+}
+
+void swr::streaming_statistics::merge(const streaming_statistics& rhs) {
+    if (!rhs.count) {
+        return;
+    }
+
+    minimum = count ? std::min(minimum, rhs.minimum) : rhs.minimum;
+    maximum = count ? std::max(maximum, rhs.maximum) : rhs.maximum;
+    sum += rhs.sum;
+    count += rhs.count;
+
+    sketch.merge(rhs.sketch);
+}
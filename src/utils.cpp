@@ -12,6 +12,7 @@
 #include <algorithm>
 #include <cmath>
 #include <numeric>
+#include <memory>
 
 #include "data.hpp"
 #include "portfolio.hpp"
@@ -29,45 +30,37 @@ std::vector<std::string> swr::parse_args(int argc, const char* argv[]) {
     return args;
 }
 
-bool swr::prepare_exchange_rates(swr::scenario& scenario, const std::string& currency) {
-    auto exchange_data     = swr::load_exchange("usd_chf");
-    auto inv_exchange_data = swr::load_exchange_inv("usd_chf");
+bool swr::prepare_exchange_rates(swr::market_data& market, const std::vector<swr::allocation>& portfolio, const std::string& currency) {
+    auto exchange_data     = swr::shared_exchange("usd_chf");
+    auto inv_exchange_data = swr::shared_exchange_inv("usd_chf");
 
-    if (exchange_data.empty() || inv_exchange_data.empty()) {
+    if (!exchange_data || !inv_exchange_data) {
         return false;
     }
 
-    const size_t N = scenario.portfolio.size();
+    const size_t N = portfolio.size();
 
-    scenario.exchange_rates.resize(N);
-    scenario.exchange_set.resize(N);
+    market.exchange_rates.resize(N);
+    market.exchange_set.resize(N);
 
     for (size_t i = 0; i < N; ++i) {
-        auto& asset = scenario.portfolio[i].asset;
+        auto& asset = portfolio[i].asset;
 
         if (currency == "usd") {
             if (asset == "ch_stocks" || asset == "ch_bonds") {
-                scenario.exchange_set[i]   = true;
-                scenario.exchange_rates[i] = inv_exchange_data;
+                market.exchange_set[i]   = true;
+                market.exchange_rates[i] = inv_exchange_data;
             } else {
-                scenario.exchange_set[i]   = false;
-                scenario.exchange_rates[i] = scenario.values[i]; // Must copy from values to keep full range
-                // We set everything to one
-                for (auto& v : scenario.exchange_rates[i]) {
-                    v.value = 1.0f;
-                }
+                market.exchange_set[i]   = false;
+                market.exchange_rates[i] = nullptr; // Not used by the simulation
             }
         } else if (currency == "chf") {
             if (asset == "ch_stocks" || asset == "ch_bonds") {
-                scenario.exchange_set[i]   = false;
-                scenario.exchange_rates[i] = scenario.values[i]; // Must copy from values to keep full range
-                // We set everything to one
-                for (auto& v : scenario.exchange_rates[i]) {
-                    v.value = 1.0f;
-                }
+                market.exchange_set[i]   = false;
+                market.exchange_rates[i] = nullptr; // Not used by the simulation
             } else {
-                scenario.exchange_set[i]   = true;
-                scenario.exchange_rates[i] = exchange_data;
+                market.exchange_set[i]   = true;
+                market.exchange_rates[i] = exchange_data;
             }
         }
     }
@@ -75,6 +68,26 @@ bool swr::prepare_exchange_rates(swr::scenario& scenario, const std::string& cur
     return true;
 }
 
+std::shared_ptr<const swr::market_data> swr::load_market_data(const std::vector<swr::allocation>& portfolio,
+                                                              const std::string&                  inflation,
+                                                              const std::string&                  currency) {
+    swr::market_data market;
+
+    market.values = swr::shared_values(portfolio);
+
+    if (market.values.empty()) {
+        return {};
+    }
+
+    market.inflation_data = swr::shared_inflation(market.values, inflation);
+
+    if (!market.inflation_data || !prepare_exchange_rates(market, portfolio, currency)) {
+        return {};
+    }
+
+    return std::make_shared<const swr::market_data>(std::move(market));
+}
+
 float swr::percentile(const std::vector<float>& v, size_t p) {
     auto point = v.size() * (p / 100.0f);
     return v[point];